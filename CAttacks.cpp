@@ -0,0 +1,144 @@
+//
+// Created by Petr Smerda on 02.09.2024.
+//
+
+#include "CAttacks.h"
+
+
+CAttacks::Magic CAttacks::m_bishopMagics[64];
+CAttacks::Magic CAttacks::m_rookMagics[64];
+
+Bitboard CAttacks::m_bishopTable[0x1480];
+Bitboard CAttacks::m_rookTable[0x19000];
+
+Bitboard CAttacks::m_between[64][64];
+Bitboard CAttacks::m_line[64][64];
+
+
+static constexpr int bishopDirections[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+static constexpr int rookDirections[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+
+void CAttacks::init() {
+  // Tables are shared by all boards, so they are built just once
+  static const bool initialized = [] {
+    initMagics(bishopDirections, m_bishopTable, m_bishopMagics);
+    initMagics(rookDirections, m_rookTable, m_rookMagics);
+    initLines();
+    return true;
+  }();
+
+  (void) initialized;
+}
+
+
+Bitboard CAttacks::slidingAttack(const int directions[4][2], int square, Bitboard occupied) {
+  Bitboard attacks = 0;
+
+  for (int i = 0; i < 4; ++i) {
+    int file = square % 8 + directions[i][0];
+    int rank = square / 8 + directions[i][1];
+
+    // Walk the ray until the edge of the board or the first blocker (included)
+    while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+      Bitboard target = 1ULL << (rank * 8 + file);
+      attacks |= target;
+
+      if (occupied & target)
+        break;
+
+      file += directions[i][0];
+      rank += directions[i][1];
+    }
+  }
+
+  return attacks;
+}
+
+
+void CAttacks::initMagics(const int directions[4][2], Bitboard table[], Magic magics[]) {
+  static constexpr Bitboard EDGE_FILES = 0x8181818181818181ULL;
+  static constexpr Bitboard EDGE_RANKS = 0xFF000000000000FFULL;
+
+  Bitboard occupancy[4096], reference[4096];
+  int epoch[4096] = {0}, attempt = 0;
+
+  // Seeds per rank known to find the magics quickly; the search is deterministic
+  static constexpr uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+  uint64_t seed = 0;
+  auto random = [&seed]() {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 2685821657736338717ULL;
+  };
+
+  Bitboard *attacks = table;
+
+  for (int square = 0; square < 64; ++square) {
+    // Board edges are not relevant for the occupancy unless the slider stands on them
+    Bitboard edges = (EDGE_RANKS & ~(0xFFULL << (square / 8 * 8))) |
+                     (EDGE_FILES & ~(0x0101010101010101ULL << (square % 8)));
+
+    Magic &m = magics[square];
+    m.mask = slidingAttack(directions, square, 0) & ~edges;
+    m.shift = 64 - __builtin_popcountll(m.mask);
+    m.attacks = attacks;
+
+    // Enumerate all subsets of the mask (Carry-Rippler trick) and store the reference attacks
+    int size = 0;
+    Bitboard subset = 0;
+    do {
+      occupancy[size] = subset;
+      reference[size] = slidingAttack(directions, square, subset);
+#if defined(USE_PEXT)
+      m.attacks[_pext_u64(subset, m.mask)] = reference[size];
+#endif
+      size++;
+      subset = (subset - m.mask) & m.mask;
+    } while (subset);
+
+    attacks += size;
+
+#if !defined(USE_PEXT)
+    seed = seeds[square / 8];
+
+    // Try sparse random numbers until one maps every occupancy without a destructive collision
+    for (int i = 0; i < size;) {
+      do {
+        m.magic = random() & random() & random();
+      } while (__builtin_popcountll((m.magic * m.mask) >> 56) < 6);
+
+      ++attempt;
+      for (i = 0; i < size; ++i) {
+        unsigned idx = m.index(occupancy[i]);
+
+        if (epoch[idx] < attempt) {
+          epoch[idx] = attempt;
+          m.attacks[idx] = reference[i];
+        } else if (m.attacks[idx] != reference[i])
+          break;
+      }
+    }
+#endif
+  }
+}
+
+
+void CAttacks::initLines() {
+  for (int from = 0; from < 64; ++from) {
+    for (int to = 0; to < 64; ++to) {
+      Bitboard fromBB = 1ULL << from;
+      Bitboard toBB = 1ULL << to;
+
+      if (rookAttacks(from, 0) & toBB) {
+        m_line[from][to] = (rookAttacks(from, 0) & rookAttacks(to, 0)) | fromBB | toBB;
+        m_between[from][to] = rookAttacks(from, toBB) & rookAttacks(to, fromBB);
+      } else if (bishopAttacks(from, 0) & toBB) {
+        m_line[from][to] = (bishopAttacks(from, 0) & bishopAttacks(to, 0)) | fromBB | toBB;
+        m_between[from][to] = bishopAttacks(from, toBB) & bishopAttacks(to, fromBB);
+      }
+    }
+  }
+}
@@ -0,0 +1,87 @@
+//
+// Created by Petr Smerda on 02.09.2024.
+//
+
+#ifndef SFML_CHESS_CATTACKS_H
+#define SFML_CHESS_CATTACKS_H
+
+#include <cstdint>
+
+#if defined(USE_PEXT)
+#include <immintrin.h>
+#endif
+
+typedef uint64_t Bitboard;
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *              Precomputed slider attack tables            *
+ *              Precomputed slider attack tables            *
+ *                                                          *
+ ************************************************************
+ */
+
+// Attack sets of sliding pieces looked up by square and board occupancy.
+// The occupancy is hashed either by magic multiplication or, when built with USE_PEXT, by the BMI2 PEXT instruction.
+class CAttacks {
+private:
+
+  struct Magic {
+    Bitboard mask;      // Relevant occupancy (ray squares without the board edge)
+    Bitboard magic;
+    Bitboard *attacks;  // Slice of the shared attack table for this square
+    unsigned shift;
+
+    unsigned index(Bitboard occupied) const {
+#if defined(USE_PEXT)
+      return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+      return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+    }
+  };
+
+  static Magic m_bishopMagics[64];
+  static Magic m_rookMagics[64];
+
+  static Bitboard m_bishopTable[0x1480];
+  static Bitboard m_rookTable[0x19000];
+
+  static Bitboard m_between[64][64];
+  static Bitboard m_line[64][64];
+
+  static Bitboard slidingAttack(const int directions[4][2], int square, Bitboard occupied);
+
+  static void initMagics(const int directions[4][2], Bitboard table[], Magic magics[]);
+
+  static void initLines();
+
+public:
+
+  static void init();
+
+  inline static Bitboard bishopAttacks(int square, Bitboard occupied) {
+    const Magic &m = m_bishopMagics[square];
+    return m.attacks[m.index(occupied)];
+  }
+
+  inline static Bitboard rookAttacks(int square, Bitboard occupied) {
+    const Magic &m = m_rookMagics[square];
+    return m.attacks[m.index(occupied)];
+  }
+
+  inline static Bitboard queenAttacks(int square, Bitboard occupied) {
+    return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+  }
+
+  // Squares strictly between two squares on a common rank, file or diagonal, empty otherwise
+  inline static Bitboard between(int from, int to) { return m_between[from][to]; }
+
+  // Whole rank, file or diagonal going through both squares, empty if they are not aligned
+  inline static Bitboard line(int from, int to) { return m_line[from][to]; }
+};
+
+
+#endif //SFML_CHESS_CATTACKS_H
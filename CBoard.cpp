@@ -3,9 +3,15 @@
 //
 
 #include "CBoard.h"
+#include <algorithm>
+#include <sstream>
+#include <string_view>
 
 
 CBoard::CBoard() {
+  CAttacks::init();
+  CZobrist::init();
+
   // Place pieces on initial positions
   wKing = 0x10ULL;
   bKing = 0x1000000000000000ULL;
@@ -32,106 +38,150 @@ CBoard::CBoard() {
 
 
   onTurn = 1;
-}
+  halfmoveClock = 0;
+
+  m_states.resize(128);
+  m_ply = 0;
+  m_startPly = 0;
 
+  Position::key = computeKey();
+  Position::pawnKey = computePawnKey();
+  Position::material = computeMaterial();
+  Position::psqt = computePsqt();
+}
 
-bool CBoard::loadTextures(const std::string texturePath[12]) const {
 
-  for (int i = 0; i < 12; ++i) {
-    if (!m_textures[i].loadFromFile(texturePath[i])) {
-      std::cerr << "Failed to load texture: " << texturePath[i] << std::endl;
-      return false;
-    }
+bool CBoard::loadFen(const std::string &fen) {
+  std::istringstream stream(fen);
+  std::string placement, side, castling = "-", enPassantSquare = "-";
+  int halfmoves = 0, fullmoves = 1;
 
-    // Assign and scale the textures to sprites
-    m_sprites[i].setTexture(m_textures[i]);
-    sf::Vector2u textureSize = m_textures[i].getSize();
+  if (!(stream >> placement >> side))
+    return false;
 
-    // Calculate the scale factor to fit within tileSize
-    float scaleFactor = static_cast<float>(TILE) / static_cast<float>(std::max(textureSize.x, textureSize.y));
-    m_sprites[i].setScale(scaleFactor, scaleFactor);
+  // The clocks are optional, EPD records end after the en passant square
+  stream >> castling >> enPassantSquare >> halfmoves >> fullmoves;
+
+  // Parse into local bitboards first, so the board is untouched if the FEN is malformed
+  const std::string pieceChars = "PNBRQKpnbrqk";
+  Bitboard pieces[12] = {0};
+  int rank = 7, file = 0;
+
+  for (char c: placement) {
+    if (c == '/') {
+      rank--;
+      file = 0;
+    } else if (c >= '1' && c <= '8')
+      file += c - '0';
+    else {
+      size_t index = pieceChars.find(c);
+      if (index == std::string::npos || file > 7 || rank < 0)
+        return false;
+
+      pieces[index] |= 1ULL << (rank * 8 + file++);
+    }
   }
 
-  lightSquareColor = sf::Color(240, 248, 255);  // Alice blue
-  darkSquareColor = sf::Color(70, 130, 180);    // Steel blue
-  borderColor = sf::Color(60, 100, 150);        // Deep blue
-  highlightSrcColor = sf::Color(0, 191, 255);   // Deep sky blue
-  highlightDstColor = sf::Color(30, 144, 255);  // Dodger blue
+  if (popcount(pieces[5]) != 1 || popcount(pieces[11]) != 1 || (side != "w" && side != "b"))
+    return false;
 
+  Position previous = *this;
 
-  m_rectangle = sf::RectangleShape(sf::Vector2f(TILE - BORDER * 2, TILE - BORDER * 2));
-  m_rectangle.setOutlineColor(borderColor);
-  m_rectangle.setOutlineThickness(BORDER);
+  wPawns = pieces[0], wKnights = pieces[1], wBishops = pieces[2], wRooks = pieces[3], wQueens = pieces[4], wKing = pieces[5];
+  bPawns = pieces[6], bKnights = pieces[7], bBishops = pieces[8], bRooks = pieces[9], bQueens = pieces[10], bKing = pieces[11];
 
-  return true;
-}
+  onTurn = side == "w" ? 1 : -1;
 
+  // The king of the side that just moved cannot be in check, the search would capture it
+  if (onTurn == 1 ? !bKingSafe(bKing) : !wKingSafe(wKing)) {
+    static_cast<Position &>(*this) = previous;
+    return false;
+  }
 
-void CBoard::draw(sf::RenderWindow &window, Bitboard moveFrom) {
+  // Castling rights are stored as the target squares of the king, kept only if king and rook are at home
+  wCastling = 0;
+  bCastling = 0;
 
-  // Drawing the board and squares
-  for (int y = 0; y < 8; ++y) {
-    for (int x = 0; x < 8; ++x) {
-      m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
-      m_rectangle.setFillColor((x + y) % 2 == 0 ? lightSquareColor : darkSquareColor);
-      window.draw(m_rectangle);
-    }
+  for (char c: castling) {
+    if (c == 'K' && (wKing & 0x10ULL) && (wRooks & 0x80ULL)) wCastling |= 0x40ULL;
+    if (c == 'Q' && (wKing & 0x10ULL) && (wRooks & 0x1ULL)) wCastling |= 0x4ULL;
+    if (c == 'k' && (bKing & 0x1000000000000000ULL) && (bRooks & 0x8000000000000000ULL)) bCastling |= 0x4000000000000000ULL;
+    if (c == 'q' && (bKing & 0x1000000000000000ULL) && (bRooks & 0x100000000000000ULL)) bCastling |= 0x400000000000000ULL;
   }
 
-  // Drawing the selected square, if any
-  if (moveFrom) {
-    int pos = __builtin_ctzll(moveFrom); // Extracting the set bit to draw it on the board
+  enPassant = 0;
+  if (enPassantSquare.size() == 2 && enPassantSquare[0] >= 'a' && enPassantSquare[0] <= 'h' &&
+      (enPassantSquare[1] == '3' || enPassantSquare[1] == '6'))
+    enPassant = 1ULL << ((enPassantSquare[1] - '1') * 8 + enPassantSquare[0] - 'a');
 
-    int x = pos % 8;
-    int y = 7 - (pos / 8);
+  halfmoveClock = std::max(halfmoves, 0);
+  m_ply = 0;
+  m_startPly = 2 * (std::max(fullmoves, 1) - 1) + (onTurn == 1 ? 0 : 1);
 
-    m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
-    m_rectangle.setFillColor(highlightSrcColor);
-    window.draw(m_rectangle);
-  }
+  Position::key = computeKey();
+  Position::pawnKey = computePawnKey();
+  Position::material = computeMaterial();
+  Position::psqt = computePsqt();
 
-  // Highlighting possible moves
-  Bitboard possibleMoves = legalMoves(moveFrom);
-  for (int square = 0; square < 64; ++square) {
-    if (possibleMoves & (1ULL << square)) {
-      int x = square % 8;
-      int y = 7 - (square / 8);
+  return true;
+}
 
-      m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
-      m_rectangle.setFillColor(highlightDstColor); // Highlight color for possible moves
-      window.draw(m_rectangle);
-    }
-  }
 
-  // Function to position pieces based on bitboard
-  auto posFromBitboard = [&](sf::Sprite &sprite, Bitboard bitboard) {
-    for (int square = 0; square < 64; ++square) {
-      if (bitboard & (1ULL << square)) {
-        int rank = square / 8;
-        int file = square % 8;
+std::string CBoard::toFen() const {
+  std::string fen;
+
+  for (int rank = 7; rank >= 0; --rank) {
+    int emptySquares = 0;
 
-        // Here I need to reverse the positions -> 7 - rank
-        sprite.setPosition(static_cast<float>(file) * TILE, static_cast<float>(7 - rank) * TILE);
+    for (int file = 0; file < 8; ++file) {
+      int square = rank * 8 + file;
+      char piece = pieceAt(square);
 
-        window.draw(sprite);
+      if (!piece) {
+        emptySquares++;
+        continue;
       }
+
+      if (emptySquares)
+        fen += static_cast<char>('0' + emptySquares);
+      emptySquares = 0;
+
+      fen += (white() & 1ULL << square) ? piece : static_cast<char>(piece - 'A' + 'a');
     }
-  };
 
-  // Draw the pieces
-  posFromBitboard(m_sprites[0], wPawns);
-  posFromBitboard(m_sprites[1], wKing);
-  posFromBitboard(m_sprites[2], wKnights);
-  posFromBitboard(m_sprites[3], wBishops);
-  posFromBitboard(m_sprites[4], wQueens);
-  posFromBitboard(m_sprites[5], wRooks);
+    if (emptySquares)
+      fen += static_cast<char>('0' + emptySquares);
+    if (rank)
+      fen += '/';
+  }
+
+  fen += whiteToMove() ? " w " : " b ";
+
+  std::string castling;
+  if (wCastling & 0x40ULL) castling += 'K';
+  if (wCastling & 0x4ULL) castling += 'Q';
+  if (bCastling & 0x4000000000000000ULL) castling += 'k';
+  if (bCastling & 0x400000000000000ULL) castling += 'q';
+  fen += castling.empty() ? "-" : castling;
+
+  if (enPassant) {
+    int square = __builtin_ctzll(enPassant);
+    fen += {' ', static_cast<char>('a' + square % 8), static_cast<char>('1' + square / 8)};
+  } else
+    fen += " -";
+
+  fen += ' ';
+  fen += std::to_string(halfmoveClock);
+  fen += ' ';
+  fen += std::to_string((m_startPly + m_ply) / 2 + 1);
+  return fen;
+}
 
-  posFromBitboard(m_sprites[6], bPawns);
-  posFromBitboard(m_sprites[7], bKing);
-  posFromBitboard(m_sprites[8], bKnights);
-  posFromBitboard(m_sprites[9], bBishops);
-  posFromBitboard(m_sprites[10], bQueens);
-  posFromBitboard(m_sprites[11], bRooks);
+
+void CBoard::setPosition(const Position &position) {
+  static_cast<Position &>(*this) = position;
+  m_ply = 0;
+  m_startPly = onTurn == 1 ? 0 : 1;
 }
 
 
@@ -153,42 +203,6 @@ bool CBoard::movePiece(Bitboard &pieces, Bitboard moveFrom, Bitboard moveTo) {
   return true;
 }
 
-void CBoard::handleCapture(Bitboard moveTo, MoveInfo &moveInfo) {
-  if (whiteToMove()) removeCapturedBlack(moveTo, moveInfo.capturedPiece, moveInfo.capturedPieceType);
-  else removeCapturedWhite(moveTo, moveInfo.capturedPiece, moveInfo.capturedPieceType);
-}
-
-void CBoard::removeCapturedBlack(Bitboard moveTo, Bitboard &removedFrom, char &pieceType) {
-  // Array of bitboards for black pieces and corresponding moveTo types
-  Bitboard *blackPieces[] = {&bPawns, &bKnights, &bBishops, &bRooks, &bQueens, &bKing};
-  char blackPieceTypes[] = {'P', 'N', 'B', 'R', 'Q', 'K'};
-
-  for (int i = 0; i < 6; ++i) {
-    if (*blackPieces[i] & moveTo) {
-      *blackPieces[i] &= ~moveTo;
-      pieceType = blackPieceTypes[i];
-      removedFrom = moveTo;
-      break;
-    }
-  }
-}
-
-void CBoard::removeCapturedWhite(Bitboard piece, Bitboard &removedFrom, char &pieceType) {
-  // Array of bitboards for white pieces and corresponding piece types
-  Bitboard *whitePieces[] = {&wPawns, &wKnights, &wBishops, &wRooks, &wQueens, &wKing};
-  char whitePieceTypes[] = {'P', 'N', 'B', 'R', 'Q', 'K'};
-
-  for (int i = 0; i < 6; ++i) {
-    if (*whitePieces[i] & piece) {
-      *whitePieces[i] &= ~piece;
-      pieceType = whitePieceTypes[i];
-      removedFrom = piece;
-      break;
-    }
-  }
-}
-
-
 /*
  ************************************************************
  *                                                          *
@@ -258,31 +272,16 @@ Bitboard CBoard::bKnightMoves(Bitboard pos) const {
  ************************************************************
  */
 
-Bitboard CBoard::sliderMoves(Bitboard pos, Bitboard (*directionFunc)(Bitboard), Bitboard enemies, Bitboard empty) {
-  Bitboard res = 0;
-  Bitboard currentPos = directionFunc(pos);
-
-  while (currentPos & (enemies | empty)) {
-    res |= currentPos;
-    if (currentPos & enemies)
-      break;
-
-    currentPos = directionFunc(currentPos);
-  }
-
-  return res;
-}
-
-
 Bitboard CBoard::bishopMoves(Bitboard pos, Bitboard enemies, Bitboard empty) {
   Bitboard res = 0;
+  Bitboard occupied = ~empty;
 
-  res |= sliderMoves(pos, noWe, enemies, empty);
-  res |= sliderMoves(pos, noEa, enemies, empty);
-  res |= sliderMoves(pos, soWe, enemies, empty);
-  res |= sliderMoves(pos, soEa, enemies, empty);
+  while (pos) {
+    res |= CAttacks::bishopAttacks(__builtin_ctzll(pos), occupied);
+    pos &= pos - 1;
+  }
 
-  return res & ~pos;  // Clear the start position
+  return res & (enemies | empty);  // Own pieces cannot be captured
 }
 
 // Wrapper functions for white and black bishops
@@ -306,15 +305,14 @@ Bitboard CBoard::bBishopMoves(Bitboard pos) const {
 
 Bitboard CBoard::rookMoves(Bitboard pos, Bitboard enemies, Bitboard empty) {
   Bitboard res = 0;
+  Bitboard occupied = ~empty;
 
+  while (pos) {
+    res |= CAttacks::rookAttacks(__builtin_ctzll(pos), occupied);
+    pos &= pos - 1;
+  }
 
-  // Apply the lambda for each straight direction
-  res |= sliderMoves(pos, nortOne, enemies, empty);
-  res |= sliderMoves(pos, eastOne, enemies, empty);
-  res |= sliderMoves(pos, soutOne, enemies, empty);
-  res |= sliderMoves(pos, westOne, enemies, empty);
-
-  return res & ~pos;  // Clear the start position
+  return res & (enemies | empty);  // Own pieces cannot be captured
 }
 
 // Wrapper functions for white and black rooks
@@ -335,9 +333,26 @@ Bitboard CBoard::bRookMoves(Bitboard pos) const {
  ************************************************************
  */
 
-Bitboard CBoard::wQueenMoves(Bitboard pos) const { return wBishopMoves(pos) | wRookMoves(pos); }
+Bitboard CBoard::queenMoves(Bitboard pos, Bitboard enemies, Bitboard empty) {
+  Bitboard res = 0;
+  Bitboard occupied = ~empty;
 
-Bitboard CBoard::bQueenMoves(Bitboard pos) const { return bBishopMoves(pos) | bRookMoves(pos); }
+  while (pos) {
+    res |= CAttacks::queenAttacks(__builtin_ctzll(pos), occupied);
+    pos &= pos - 1;
+  }
+
+  return res & (enemies | empty);  // Own pieces cannot be captured
+}
+
+// Wrapper functions for white and black queens
+Bitboard CBoard::wQueenMoves(Bitboard pos) const {
+  return queenMoves(pos, black(), empty());
+}
+
+Bitboard CBoard::bQueenMoves(Bitboard pos) const {
+  return queenMoves(pos, white(), empty());
+}
 
 
 /*
@@ -353,34 +368,50 @@ Bitboard CBoard::oneAround(Bitboard pos) {
   return nortOne(pos) | soutOne(pos) | eastOne(pos) | westOne(pos) | noWe(pos) | noEa(pos) | soWe(pos) | soEa(pos);
 }
 
-Bitboard CBoard::wKingSafe(Bitboard pos) const {
-  Bitboard blackAttacks = 0;
+Bitboard CBoard::wAttacks(Bitboard occupied) const {
+  // Pawns must be just attacking
+  Bitboard attacks = wPawnEastAttacks(wPawns) | wPawnWestAttacks(wPawns) | knightAttacks(wKnights) | oneAround(wKing);
 
-  // Pawn must be just attacking
-  blackAttacks |= bPawnEastAttacks(bPawns);
-  blackAttacks |= bPawnWestAttacks(bPawns);
-  blackAttacks |= bKnightMoves(bKnights);
-  blackAttacks |= bBishopMoves(bBishops);
-  blackAttacks |= bRookMoves(bRooks);
-  blackAttacks |= bQueenMoves(bQueens);
-  blackAttacks |= oneAround(bKing);
+  for (auto piece: CBitboardRange(wBishops | wQueens))
+    attacks |= CAttacks::bishopAttacks(__builtin_ctzll(piece), occupied);
 
-  return pos & ~blackAttacks; // Return squares not attacked by white and bKing
-}
+  for (auto piece: CBitboardRange(wRooks | wQueens))
+    attacks |= CAttacks::rookAttacks(__builtin_ctzll(piece), occupied);
 
-Bitboard CBoard::bKingSafe(Bitboard pos) const {
-  Bitboard whiteAttacks = 0;
+  return attacks;
+}
 
+Bitboard CBoard::bAttacks(Bitboard occupied) const {
   // Pawns must be just attacking
-  whiteAttacks |= wPawnEastAttacks(wPawns);
-  whiteAttacks |= wPawnWestAttacks(wPawns);
-  whiteAttacks |= wKnightMoves(wKnights);
-  whiteAttacks |= wBishopMoves(wBishops);
-  whiteAttacks |= wRookMoves(wRooks);
-  whiteAttacks |= wQueenMoves(wQueens);
-  whiteAttacks |= oneAround(wKing);
+  Bitboard attacks = bPawnEastAttacks(bPawns) | bPawnWestAttacks(bPawns) | knightAttacks(bKnights) | oneAround(bKing);
+
+  for (auto piece: CBitboardRange(bBishops | bQueens))
+    attacks |= CAttacks::bishopAttacks(__builtin_ctzll(piece), occupied);
 
-  return pos & ~whiteAttacks; // Return squares not attacked by white and bKing
+  for (auto piece: CBitboardRange(bRooks | bQueens))
+    attacks |= CAttacks::rookAttacks(__builtin_ctzll(piece), occupied);
+
+  return attacks;
+}
+
+Bitboard CBoard::attackersTo(int square, Bitboard occupied) const {
+  Bitboard pos = 1ULL << square;
+
+  // A white pawn attacks the square if a black pawn standing there would attack the white one
+  return ((bPawnEastAttacks(pos) | bPawnWestAttacks(pos)) & wPawns) |
+         ((wPawnEastAttacks(pos) | wPawnWestAttacks(pos)) & bPawns) |
+         (knightAttacks(pos) & (wKnights | bKnights)) |
+         (oneAround(pos) & (wKing | bKing)) |
+         (CAttacks::bishopAttacks(square, occupied) & (wBishops | bBishops | wQueens | bQueens)) |
+         (CAttacks::rookAttacks(square, occupied) & (wRooks | bRooks | wQueens | bQueens));
+}
+
+Bitboard CBoard::wKingSafe(Bitboard pos) const {
+  return pos & ~bAttacks(white() | black()); // Return squares not attacked by black
+}
+
+Bitboard CBoard::bKingSafe(Bitboard pos) const {
+  return pos & ~wAttacks(white() | black()); // Return squares not attacked by white
 }
 
 Bitboard CBoard::wKingMoves(Bitboard pos) const {
@@ -449,369 +480,630 @@ Bitboard CBoard::pseudoLegalMoves(Bitboard pos) const {
 }
 
 
-Bitboard CBoard::legalMoves(Bitboard pos) {
-  Bitboard legalMoves = 0;
+/*
+ ************************************************************
+ *                                                          *
+ *                   Legal move generation                  *
+ *                   Legal move generation                  *
+ *                                                          *
+ ************************************************************
+ */
+
+
+CBoard::CheckInfo CBoard::checkInfo() const {
+  bool isWhite = whiteToMove();
+  Bitboard king = isWhite ? wKing : bKing;
+  Bitboard own = isWhite ? white() : black();
+  Bitboard occupied = white() | black();
+
+  Bitboard enemyPawns = isWhite ? bPawns : wPawns;
+  Bitboard enemyKnights = isWhite ? bKnights : wKnights;
+  Bitboard enemyBishops = isWhite ? bBishops | bQueens : wBishops | wQueens;
+  Bitboard enemyRooks = isWhite ? bRooks | bQueens : wRooks | wQueens;
+
+  int kingSquare = __builtin_ctzll(king);
+  CheckInfo info = {0, 0, ~0ULL, 0};
 
-  for (auto moveFrom: CBitboardRange(pos)) {
+  Bitboard pawnAttackers = isWhite ? wPawnEastAttacks(king) | wPawnWestAttacks(king)
+                                   : bPawnEastAttacks(king) | bPawnWestAttacks(king);
 
-    Bitboard possibleMoves = pseudoLegalMoves(moveFrom);
+  info.checkers = (pawnAttackers & enemyPawns) | (knightAttacks(king) & enemyKnights) |
+                  (CAttacks::bishopAttacks(kingSquare, occupied) & enemyBishops) |
+                  (CAttacks::rookAttacks(kingSquare, occupied) & enemyRooks);
 
-    // Appending all the moves from possibleMoves that are legal to result
-    for (auto moveTo: CBitboardRange(possibleMoves))
-      if (isMoveLegal(moveFrom, moveTo))
-        legalMoves |= moveTo;
+  // Sliders aiming at the king through exactly one piece either pin it (own piece) or are harmless
+  Bitboard snipers = (CAttacks::bishopAttacks(kingSquare, 0) & enemyBishops) |
+                     (CAttacks::rookAttacks(kingSquare, 0) & enemyRooks);
+
+  for (auto sniper: CBitboardRange(snipers)) {
+    Bitboard blockers = CAttacks::between(kingSquare, __builtin_ctzll(sniper)) & occupied;
+
+    if (blockers && !(blockers & (blockers - 1)))
+      info.pinned |= blockers & own;
   }
 
+  // In check the piece must be captured or the ray blocked, in double check only the king may move
+  if (info.checkers)
+    info.checkMask = (info.checkers & (info.checkers - 1)) ? 0 :
+                     CAttacks::between(kingSquare, __builtin_ctzll(info.checkers)) | info.checkers;
+
+  info.kingDanger = isWhite ? bAttacks(occupied & ~king) : wAttacks(occupied & ~king);
+
+  return info;
+}
+
+
+Bitboard CBoard::kingTargets(Bitboard king, const CheckInfo &info) const {
+  bool isWhite = whiteToMove();
+  Bitboard targets = oneAround(king) & ~onMovePositions() & ~info.kingDanger;
+
+  // No castling out of check
+  if (info.checkers)
+    return targets;
+
+  Bitboard castling = isWhite ? wCastling : bCastling;
+  Bitboard rooks = isWhite ? wRooks : bRooks;
+  Bitboard occupied = white() | black();
+
+  // King side - the squares between king and rook must be empty and the king may not pass an attacked square
+  if ((castling & king << 2) && (rooks & king << 3) && !((king << 1 | king << 2) & (occupied | info.kingDanger)))
+    targets |= king << 2;
+
+  // Queen side - the knight square must be empty as well, but it may be attacked
+  if ((castling & king >> 2) && (rooks & king >> 4) && !((king >> 1 | king >> 2 | king >> 3) & occupied) &&
+      !((king >> 1 | king >> 2) & info.kingDanger))
+    targets |= king >> 2;
+
+  return targets;
+}
+
+
+bool CBoard::isEnPassantLegal(Bitboard moveFrom, const CheckInfo &info) const {
+  bool isWhite = whiteToMove();
+  Bitboard captured = isWhite ? soutOne(enPassant) : nortOne(enPassant);
+
+  Bitboard enemyBishops = isWhite ? bBishops | bQueens : wBishops | wQueens;
+  Bitboard enemyRooks = isWhite ? bRooks | bQueens : wRooks | wQueens;
+
+  // Checks by a pawn or a knight can be resolved only by capturing the checking pawn
+  if (info.checkers & ~(enemyBishops | enemyRooks) & ~captured)
+    return false;
+
+  // Both pawns leave their squares at once, so look for any slider hitting the king afterwards
+  int kingSquare = __builtin_ctzll(isWhite ? wKing : bKing);
+  Bitboard occupied = ((white() | black()) & ~moveFrom & ~captured) | enPassant;
+
+  return !(CAttacks::bishopAttacks(kingSquare, occupied) & enemyBishops) &&
+         !(CAttacks::rookAttacks(kingSquare, occupied) & enemyRooks);
+}
+
+
+Bitboard CBoard::legalTargets(Bitboard moveFrom, const CheckInfo &info) const {
+  bool isWhite = whiteToMove();
+  Bitboard king = isWhite ? wKing : bKing;
+
+  if (moveFrom & king)
+    return kingTargets(king, info);
+
+  // Double check
+  if (!info.checkMask)
+    return 0;
+
+  Bitboard targets;
+  Bitboard enPassantTarget = 0;
+
+  if (moveFrom & (isWhite ? wPawns : bPawns)) {
+    targets = isWhite ? wPawnMoves(moveFrom) : bPawnMoves(moveFrom);
+    enPassantTarget = targets & enPassant;
+    targets &= ~enPassant;
+  } else if (moveFrom & (isWhite ? wKnights : bKnights))
+    targets = isWhite ? wKnightMoves(moveFrom) : bKnightMoves(moveFrom);
+  else if (moveFrom & (isWhite ? wBishops : bBishops))
+    targets = isWhite ? wBishopMoves(moveFrom) : bBishopMoves(moveFrom);
+  else if (moveFrom & (isWhite ? wRooks : bRooks))
+    targets = isWhite ? wRookMoves(moveFrom) : bRookMoves(moveFrom);
+  else
+    targets = isWhite ? wQueenMoves(moveFrom) : bQueenMoves(moveFrom);
+
+  targets &= info.checkMask;
+
+  if (moveFrom & info.pinned)
+    targets &= CAttacks::line(__builtin_ctzll(king), __builtin_ctzll(moveFrom));
+
+  if (enPassantTarget && isEnPassantLegal(moveFrom, info))
+    targets |= enPassantTarget;
+
+  return targets;
+}
+
+
+Bitboard CBoard::legalMoves(Bitboard pos) const {
+  Bitboard legalMoves = 0;
+  pos &= onMovePositions();
+
+  if (!pos)
+    return 0;
+
+  CheckInfo info = checkInfo();
+
+  for (auto moveFrom: CBitboardRange(pos))
+    legalMoves |= legalTargets(moveFrom, info);
+
   return legalMoves;
 }
 
 
-bool CBoard::isMoveLegal(Bitboard from, Bitboard to) {
-  // If we cannot make the move we don't want to unmake it, so return false and the move is not legal
-  if (!makeMove(from, to))
+bool CBoard::isMoveLegal(Bitboard from, Bitboard to) const {
+  return (to & legalMoves(from)) != 0;
+}
+
+
+bool CBoard::inCheck() const {
+  return whiteToMove() ? !wKingSafe(wKing) : !bKingSafe(bKing);
+}
+
+
+bool CBoard::isDraw() const {
+  // Mate given with the hundredth half move still counts
+  if (halfmoveClock >= 100) {
+    if (!inCheck())
+      return true;
+
+    CMoveList moves;
+    generateMoves(moves);
+    return !moves.empty();
+  }
+
+  // m_states[m_ply - k + 1] holds the key k plies back. Nothing before the last irreversible move can repeat, and a
+  // null move is not a real move, so the search stops there too.
+  int plies = std::min(halfmoveClock, m_ply);
+
+  for (int k = 1; k <= plies; ++k) {
+    const StateInfo &state = m_states[m_ply - k + 1];
+    if (!state.move)
+      return false;
+
+    if (k % 2 == 0 && state.key == Position::key)
+      return true;
+  }
+
+  return false;
+}
+
+
+bool CBoard::isMoveLegal(CMove move) const {
+  if (!move || !(move.fromBB() & onMovePositions()))
     return false;
 
-  bool isValid = whiteToMove() ? bKingSafe(bKing) : wKingSafe(wKing);
-  unmakeMove();
+  CMoveList moves;
+  addMoves(move.fromBB(), legalTargets(move.fromBB(), checkInfo()) & move.toBB(), moves);
 
-  return isValid;
+  for (CMove legal: moves)
+    if (legal == move)
+      return true;
+
+  return false;
 }
 
 
-std::vector<std::pair<Bitboard, Bitboard>> CBoard::generateMoves(Bitboard moveFrom) {
-  // in moveFrom must be just one bit set
-  if ((moveFrom & (moveFrom - 1)) != 0)
-    throw std::invalid_argument("expected 1 bit set, got more");
+char CBoard::pieceAt(int square) const {
+  Bitboard pos = 1ULL << square;
 
-  std::vector<std::pair<Bitboard, Bitboard>> moves;
-  Bitboard possibleMoves = legalMoves(moveFrom);
+  if (pos & (wPawns | bPawns))
+    return 'P';
+  if (pos & (wKnights | bKnights))
+    return 'N';
+  if (pos & (wBishops | bBishops))
+    return 'B';
+  if (pos & (wRooks | bRooks))
+    return 'R';
+  if (pos & (wQueens | bQueens))
+    return 'Q';
+  if (pos & (wKing | bKing))
+    return 'K';
 
-  for (auto moveTo: CBitboardRange(possibleMoves))
-    moves.emplace_back(moveFrom, moveTo);
+  return 0;
+}
 
 
-  return moves;
+Bitboard CBoard::pieces(char pieceType, bool isWhite) const {
+  switch (pieceType) {
+    case 'P': return isWhite ? wPawns : bPawns;
+    case 'N': return isWhite ? wKnights : bKnights;
+    case 'B': return isWhite ? wBishops : bBishops;
+    case 'R': return isWhite ? wRooks : bRooks;
+    case 'Q': return isWhite ? wQueens : bQueens;
+    case 'K': return isWhite ? wKing : bKing;
+    default: return 0;
+  }
+}
+
+
+void CBoard::addMoves(Bitboard moveFrom, Bitboard targets, CMoveList &moves) const {
+  bool isWhite = whiteToMove();
+  int from = __builtin_ctzll(moveFrom);
+
+  Bitboard enemies = isWhite ? black() : white();
+  Bitboard lastRank = isWhite ? RANK_8 : RANK_1;
+  bool isPawn = moveFrom & (isWhite ? wPawns : bPawns);
+  bool isKing = moveFrom & (isWhite ? wKing : bKing);
+
+  for (auto moveTo: CBitboardRange(targets)) {
+    int to = __builtin_ctzll(moveTo);
+    int flags = (moveTo & enemies) ? CMove::CAPTURE : CMove::QUIET;
+
+    if (isPawn) {
+      if (moveTo & enPassant)
+        flags = CMove::EN_PASSANT;
+      else if (moveTo & lastRank) {
+        // One move for each promotion piece (knight, bishop, rook, queen)
+        for (int piece = 0; piece < 4; ++piece)
+          moves.push_back(CMove(from, to, flags | CMove::PROMOTION | piece));
+        continue;
+      } else if (to - from == 16 || from - to == 16)
+        flags = CMove::DOUBLE_PUSH;
+    } else if (isKing) {
+      if (to == from + 2)
+        flags = CMove::KING_CASTLE;
+      else if (to == from - 2)
+        flags = CMove::QUEEN_CASTLE;
+    }
+
+    moves.push_back(CMove(from, to, flags));
+  }
+}
+
+
+void CBoard::generateMoves(CMoveList &moves, GenType type) const {
+  bool isWhite = whiteToMove();
+  CheckInfo info = checkInfo();
+
+  Bitboard pawns = isWhite ? wPawns : bPawns;
+  Bitboard enemies = isWhite ? black() : white();
+
+  // Target squares of the capture part, pawns also capture en passant and promote on the last rank
+  Bitboard pieceCaptures = enemies;
+  Bitboard pawnCaptures = enemies | enPassant | (isWhite ? RANK_8 : RANK_1);
+
+  for (auto moveFrom: CBitboardRange(onMovePositions())) {
+    Bitboard targets = legalTargets(moveFrom, info);
+
+    if (type != GEN_ALL) {
+      Bitboard captures = (moveFrom & pawns) ? pawnCaptures : pieceCaptures;
+      targets &= type == GEN_CAPTURES ? captures : ~captures;
+    }
+
+    addMoves(moveFrom, targets, moves);
+  }
+}
+
+
+CMove CBoard::findMove(Bitboard from, Bitboard to, char promotion) const {
+  CMoveList moves;
+  generateMoves(moves);
+
+  for (CMove move: moves)
+    if (move.fromBB() == from && move.toBB() == to && (!move.isPromotion() || move.promotionPiece() == promotion))
+      return move;
+
+  return CMove();
 }
 
 
 /*
  ************************************************************
  *                                                          *
- *               Move making and Unmaking                   *
- *               Move making and Unmaking                   *
+ *               Static exchange evaluation                 *
+ *               Static exchange evaluation                 *
  *                                                          *
  ************************************************************
  */
 
 
+int CBoard::pieceValue(char pieceType) {
+  switch (pieceType) {
+    case 'P': return PAWN_VALUE;
+    case 'N': return KNIGHT_VALUE;
+    case 'B': return BISHOP_VALUE;
+    case 'R': return ROOK_VALUE;
+    case 'Q': return QUEEN_VALUE;
+    case 'K': return KING_VALUE;
+    default:  return 0;
+  }
+}
 
-bool CBoard::movePieceIfValid(Bitboard &pieceSet, Bitboard moveFrom, Bitboard moveTo) {
-  if (pieceSet & moveFrom)
-    return movePiece(pieceSet, moveFrom, moveTo);
 
-  return false;
-}
+int CBoard::see(CMove move) const {
+  int to = move.to();
+  Bitboard fromBB = move.fromBB();
+  Bitboard occupied = white() | black();
+  Bitboard diagonal = wBishops | bBishops | wQueens | bQueens;
+  Bitboard straight = wRooks | bRooks | wQueens | bQueens;
 
-char CBoard::showPromotionWindow() {
-  sf::RenderWindow promotionWindow(sf::VideoMode(400, 100), "Pawn Promotion");
+  // gain[d] is the material balance for the side making the d-th capture, if the sequence stopped there
+  int gain[32];
+  int d = 0;
+  char attacker = pieceAt(move.from());
 
-  sf::Font font;
-  if (!font.loadFromFile("/System/Library/Fonts/Supplemental/Arial.ttf")) {
-    std::cerr << "Error loading font\n";
-    std::cout << "font cannot be loaded" << std::endl;
-    return 'Q';  // Default to Queen if font fails to load
+  if (move.isEnPassant()) {
+    gain[0] = PAWN_VALUE;
+    occupied ^= whiteToMove() ? soutOne(move.toBB()) : nortOne(move.toBB());
+  } else
+    gain[0] = pieceValue(pieceAt(to));
+
+  if (move.isPromotion()) {
+    attacker = move.promotionPiece();
+    gain[0] += pieceValue(attacker) - PAWN_VALUE;
   }
 
-  // Creating text objects for promotion options
-  sf::Text queenText("Q - Queen", font, 20);
-  sf::Text rookText("R - Rook", font, 20);
-  sf::Text bishopText("B - Bishop", font, 20);
-  sf::Text knightText("N - Knight", font, 20);
-
-  queenText.setPosition(20, 5);
-  rookText.setPosition(20, 25);
-  bishopText.setPosition(20, 45);
-  knightText.setPosition(20, 65);
-
-  queenText.setFillColor(sf::Color::Black);
-  rookText.setFillColor(sf::Color::Black);
-  bishopText.setFillColor(sf::Color::Black);
-  knightText.setFillColor(sf::Color::Black);
-
-  char chosenPiece = 'Q';  // Default promotion to Queen
-
-  while (promotionWindow.isOpen()) {
-    sf::Event event = sf::Event();
-    while (promotionWindow.pollEvent(event)) {
-      if (event.type == sf::Event::Closed)
-        promotionWindow.close();
-
-      if (event.type == sf::Event::KeyPressed) {
-        switch (event.key.code) {
-          case sf::Keyboard::Q:
-            chosenPiece = 'Q';
-            promotionWindow.close();
-            break;
-          case sf::Keyboard::R:
-            chosenPiece = 'R';
-            promotionWindow.close();
-            break;
-          case sf::Keyboard::B:
-            chosenPiece = 'B';
-            promotionWindow.close();
-            break;
-          case sf::Keyboard::N:
-            chosenPiece = 'N';
-            promotionWindow.close();
-            break;
-          default:
-            break;
-        }
-      }
-    }
+  Bitboard attackers = attackersTo(to, occupied);
+  bool isWhite = whiteToMove();
+
+  while (d < 31) {
+    d++;
+    gain[d] = pieceValue(attacker) - gain[d - 1];
+
+    // Neither side can gain anything by continuing
+    if (std::max(-gain[d - 1], gain[d]) < 0)
+      break;
+
+    // Removing the attacker uncovers the sliders behind it (x-rays)
+    occupied ^= fromBB;
+    attackers |= (CAttacks::bishopAttacks(to, occupied) & diagonal) | (CAttacks::rookAttacks(to, occupied) & straight);
+    attackers &= occupied;
 
-    promotionWindow.clear(sf::Color::White);
-    promotionWindow.draw(queenText);
-    promotionWindow.draw(rookText);
-    promotionWindow.draw(bishopText);
-    promotionWindow.draw(knightText);
-    promotionWindow.display();
+    isWhite = !isWhite;
+    Bitboard own = attackers & (isWhite ? white() : black());
+    if (!own)
+      break;
+
+    // Least valuable attacker recaptures next
+    const Bitboard pieces[6] = {isWhite ? wPawns : bPawns, isWhite ? wKnights : bKnights,
+                                isWhite ? wBishops : bBishops, isWhite ? wRooks : bRooks,
+                                isWhite ? wQueens : bQueens, isWhite ? wKing : bKing};
+
+    for (int type = 0; type < 6; ++type)
+      if (pieces[type] & own) {
+        fromBB = pieces[type] & own & -(pieces[type] & own);
+        attacker = "PNBRQK"[type];
+        break;
+      }
   }
 
-  return chosenPiece;
-}
+  // Each side may stop capturing whenever continuing would lose material
+  while (--d)
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
 
+  return gain[0];
+}
 
-Bitboard CBoard::isPromotion() const { return (bPawns | wPawns) & (RANK_8 | RANK_1); }
 
+/*
+ ************************************************************
+ *                                                          *
+ *               Move making and Unmaking                   *
+ *               Move making and Unmaking                   *
+ *                                                          *
+ ************************************************************
+ */
 
-void CBoard::handlePromotion(char promotedPiece) {
-  Bitboard pawns = bPawns | wPawns;
-  // Handle promotion
-  if (pawns & (RANK_8 | RANK_1)) {
 
-    std::cout << "promoting to: " << promotedPiece << std::endl;
-    // Replace the pawn with the chosen piece
-    switch (promotedPiece) {
-      case 'Q':
-        wQueens |= wPawns & RANK_8;
-        bQueens |= bPawns & RANK_1;
-        m_moveList.top().promotedTo = wPawns & RANK_8 ? &wQueens : &bQueens;
-        break;
-      case 'R':
-        wRooks |= wPawns & RANK_8;
-        bRooks |= bPawns & RANK_1;
-        m_moveList.top().promotedTo = wPawns & RANK_8 ? &wRooks : &bRooks;
-        break;
-      case 'B':
-        wBishops |= wPawns & RANK_8;
-        bBishops |= bPawns & RANK_1;
-        m_moveList.top().promotedTo = wPawns & RANK_8 ? &wBishops : &bBishops;
-        break;
-      case 'N':
-        wKnights |= wPawns & RANK_8;
-        bKnights |= bPawns & RANK_1;
-        m_moveList.top().promotedTo = wPawns & RANK_8 ? &wKnights : &bKnights;
-        break;
-      default:
-        break;
-    }
 
-    wPawns &= ~RANK_8;
-    bPawns &= ~RANK_1;
+Bitboard &CBoard::pieceSet(char pieceType, bool isWhite) {
+  switch (pieceType) {
+    case 'P': return isWhite ? wPawns : bPawns;
+    case 'N': return isWhite ? wKnights : bKnights;
+    case 'B': return isWhite ? wBishops : bBishops;
+    case 'R': return isWhite ? wRooks : bRooks;
+    case 'Q': return isWhite ? wQueens : bQueens;
+    default: return isWhite ? wKing : bKing;
   }
 }
 
 
-bool
-CBoard::handlePawnMove(Bitboard &pawns, Bitboard moveFrom, Bitboard moveTo, bool &enPassantSet, MoveInfo &moveInfo) {
-  if (!(pawns & moveFrom)) return false;
+CBoard::StateInfo &CBoard::pushState(CMove move) {
+  if (static_cast<size_t>(++m_ply) >= m_states.size())
+    m_states.resize(m_ply * 2);
+
+  StateInfo &state = m_states[m_ply];
+  state.move = move;
+  state.capturedPiece = 0;
+  state.enPassant = enPassant;
+  state.wCastling = wCastling;
+  state.bCastling = bCastling;
+  state.halfmoveClock = halfmoveClock;
+  state.key = Position::key;
+  state.pawnKey = Position::pawnKey;
+  state.material = Position::material;
+  state.psqt = Position::psqt;
+#ifdef COPY_MAKE
+  state.position = *this;
+#endif
+
+  // Without a network the changes are not noted at all, should one be loaded later this ply forces a refresh
+  state.dirtyCount = CNnue::loaded() ? 0 : -1;
+  return state;
+}
 
-  movePiece(pawns, moveFrom, moveTo);
 
-  if (moveTo & enPassant) {
-    // En-passant capture
-    removeCapturedBlack(whiteToMove() ? soutOne(moveTo) : nortOne(moveTo), moveInfo.capturedPiece,
-                        moveInfo.capturedPieceType);
-  } else if (whiteToMove() ? (moveTo & nortTwo(moveFrom)) : (moveTo & soutTwo(moveFrom))) {
-    // Set en-passant possibility
-    enPassant = whiteToMove() ? nortOne(moveFrom) : soutOne(moveFrom);
-    enPassantSet = true;
-  }
+void CBoard::handleCapture(CMove move, StateInfo &state) {
+  bool isWhite = whiteToMove();
+  Bitboard captured = move.toBB();
+  char pieceType = 'P';
 
-  return true;
+  // The pawn taken en passant stands behind the target square
+  if (move.isEnPassant())
+    captured = isWhite ? soutOne(captured) : nortOne(captured);
+  else
+    pieceType = pieceAt(move.to());
+
+  pieceSet(pieceType, !isWhite) &= ~captured;
+  hashPiece(pieceType, !isWhite, captured);
+  scorePiece(pieceType, !isWhite, captured, 0);
+
+  state.capturedPiece = pieceType;
+  state.capturedSquare = captured;
 }
 
 
-bool CBoard::handleRookMove(Bitboard &rooks, Bitboard moveFrom, Bitboard moveTo, Bitboard &castlingRights) {
-  if (!(rooks & moveFrom)) return false;
+void CBoard::handleCastling(CMove move) {
+  bool isWhite = whiteToMove();
+  Bitboard moveFrom = move.fromBB();
 
-  movePiece(rooks, moveFrom, moveTo);
-  // Disable castling rights on the side the rook moved
-  castlingRights &= eastTwo(rooks) | westOne(rooks);
+  // King-side rook jumps from the corner next to the king, queen-side one from the far corner
+  Bitboard rookFrom = move.flags() == CMove::KING_CASTLE ? moveFrom << 3 : moveFrom >> 4;
+  Bitboard rookTo = move.flags() == CMove::KING_CASTLE ? moveFrom << 1 : moveFrom >> 1;
 
-  return true;
+  movePiece(isWhite ? wRooks : bRooks, rookFrom, rookTo);
+  hashPiece('R', isWhite, rookFrom | rookTo);
+  scorePiece('R', isWhite, rookFrom, rookTo);
 }
 
-bool CBoard::handleKingMove(Bitboard &king, Bitboard &rooks, Bitboard moveFrom, Bitboard moveTo,
-                            Bitboard &castlingRights) const {
-  if (!(king & moveFrom)) return false;
 
-  movePiece(king, moveFrom, moveTo);
+void CBoard::handlePromotion(Bitboard moveTo, char promotedPiece) {
+  bool isWhite = whiteToMove();
 
-  // Handle castling
-  if (king & castlingRights) {
-    Bitboard rookFrom = (moveTo & (whiteToMove() ? (1ULL << 2) : (1ULL << 58))) ? 1ULL : (whiteToMove() ? (1ULL << 7)
-                                                                                                        : (1ULL << 63));
-    Bitboard rookTo = (rookFrom & 1ULL) ? (whiteToMove() ? (1ULL << 3) : (1ULL << 59)) : (whiteToMove() ? (1ULL << 5)
-                                                                                                        : (1ULL << 61));
-    movePiece(rooks, rookFrom, rookTo);
-  }
+  // Replace the pawn with the chosen piece
+  (isWhite ? wPawns : bPawns) &= ~moveTo;
+  pieceSet(promotedPiece, isWhite) |= moveTo;
 
-  // Disable castling rights if the king moves
-  castlingRights = 0;
+  hashPiece('P', isWhite, moveTo);
+  hashPiece(promotedPiece, isWhite, moveTo);
+  scorePiece('P', isWhite, moveTo, 0);
+  scorePiece(promotedPiece, isWhite, 0, moveTo);
+}
 
-  return true;
+
+void CBoard::updateCastlingRights(Bitboard moveFrom, Bitboard moveTo) {
+  Bitboard touched = moveFrom | moveTo;
+
+  // Moving the king disables both sides
+  if (touched & 0x10ULL) wCastling = 0;
+  if (touched & 0x1000000000000000ULL) bCastling = 0;
+
+  // Moving the rook or capturing it in the corner disables the side of that rook
+  wCastling &= ~(((touched & 0x1ULL) << 2) | ((touched & 0x80ULL) >> 1));
+  bCastling &= ~(((touched & 0x100000000000000ULL) << 2) | ((touched & 0x8000000000000000ULL) >> 1));
 }
 
 
-bool CBoard::makeMove(const Bitboard moveFrom, const Bitboard moveTo) {
-  Bitboard pseudoMoves = pseudoLegalMoves(moveFrom);
+bool CBoard::makeMove(CMove move) {
+  Bitboard moveFrom = move.fromBB();
+  Bitboard moveTo = move.toBB();
 
-  if (!(moveTo & pseudoMoves))
+  // The move is expected to be legal (from generateMoves / findMove), so just check the piece is ours
+  if (!move || !(moveFrom & onMovePositions()))
     return false;
 
   // Must store the info before the move
-  MoveInfo moveInfo = {moveFrom, moveTo, 0, enPassant, onTurn == 1 ? wCastling : bCastling, onTurn, false, 0, 0, nullptr};
+  StateInfo &state = pushState(move);
+  int previousCastling = castlingIndex();
 
   bool isWhite = whiteToMove();
-  bool enPassantSet = false;
-  Bitboard &knights = isWhite ? wKnights : bKnights;
-  Bitboard &bishops = isWhite ? wBishops : bBishops;
-  Bitboard &queens = isWhite ? wQueens : bQueens;
-  Bitboard &pawns = isWhite ? wPawns : bPawns;
-  Bitboard &rooks = isWhite ? wRooks : bRooks;
-  Bitboard &king = isWhite ? wKing : bKing;
-  Bitboard &castling = isWhite ? wCastling : bCastling;
+  char pieceType = pieceAt(move.from());
+  state.movedPiece = pieceType;
 
-  // Move piece
-  if (movePieceIfValid(knights, moveFrom, moveTo) || movePieceIfValid(bishops, moveFrom, moveTo) ||
-      movePieceIfValid(queens, moveFrom, moveTo) ||
-      handlePawnMove(pawns, moveFrom, moveTo, enPassantSet, moveInfo) ||
-      handleRookMove(rooks, moveFrom, moveTo, castling) ||
-      handleKingMove(king, rooks, moveFrom, moveTo, castling)) {
+  // The captured piece goes first, while its square still tells its type
+  if (move.isCapture())
+    handleCapture(move, state);
 
-    handleCapture(moveTo, moveInfo);
+  movePiece(pieceSet(pieceType, isWhite), moveFrom, moveTo);
+  hashPiece(pieceType, isWhite, moveFrom | moveTo);
+  scorePiece(pieceType, isWhite, moveFrom, moveTo);
 
-    if (!enPassantSet)
-      enPassant = 0;
+  if (move.isCastling())
+    handleCastling(move);
 
-    onTurn *= -1;
+  if (move.isPromotion())
+    handlePromotion(moveTo, move.promotionPiece());
 
-    moveInfo.isPromotion = isPromotion();
+  updateCastlingRights(moveFrom, moveTo);
 
-    m_moveList.push(moveInfo);
+  // En passant is possible only right after the double push, on the square the pawn skipped
+  enPassant = move.isDoublePush() ? (isWhite ? nortOne(moveFrom) : soutOne(moveFrom)) : 0;
+  halfmoveClock = pieceType == 'P' || move.isCapture() ? 0 : halfmoveClock + 1;
+  onTurn *= -1;
 
-    return true;
-  }
+  // Swap the old castling rights, en passant file and side for the new ones
+  Position::key ^= CZobrist::castling(previousCastling) ^ CZobrist::castling(castlingIndex()) ^ CZobrist::side();
+  if (state.enPassant)
+    Position::key ^= CZobrist::enPassant(__builtin_ctzll(state.enPassant) % 8);
+  if (enPassant)
+    Position::key ^= CZobrist::enPassant(__builtin_ctzll(enPassant) % 8);
 
-  return false;
+  return true;
 }
 
 bool CBoard::unmakeMove() {
-  if (m_moveList.empty()) return false;
-
-  MoveInfo lastMove = m_moveList.top();
-  m_moveList.pop();
-
-  bool isWhiteMove = (lastMove.previousOnTurn == 1);
-
-  Bitboard &pawns = isWhiteMove ? wPawns : bPawns;
-  Bitboard &knights = isWhiteMove ? wKnights : bKnights;
-  Bitboard &bishops = isWhiteMove ? wBishops : bBishops;
-  Bitboard &rooks = isWhiteMove ? wRooks : bRooks;
-  Bitboard &queens = isWhiteMove ? wQueens : bQueens;
-  Bitboard &king = isWhiteMove ? wKing : bKing;
-
-  Bitboard &opponentPawns = isWhiteMove ? bPawns : wPawns;
-  Bitboard &opponentKnights = isWhiteMove ? bKnights : wKnights;
-  Bitboard &opponentBishops = isWhiteMove ? bBishops : wBishops;
-  Bitboard &opponentRooks = isWhiteMove ? bRooks : wRooks;
-  Bitboard &opponentQueens = isWhiteMove ? bQueens : wQueens;
-  Bitboard &opponentKing = isWhiteMove ? bKing : wKing;
-
-  // Unmake the move
-  if (!unmakePieceMove(pawns, lastMove) && !unmakePieceMove(knights, lastMove) &&
-      !unmakePieceMove(bishops, lastMove) && !unmakePieceMove(rooks, lastMove) &&
-      !unmakePieceMove(queens, lastMove) && !unmakePieceMove(king, lastMove)) {
-    return false;
+  if (m_ply == 0) return false;
+
+  const StateInfo &state = m_states[m_ply--];
+
+#ifdef COPY_MAKE
+  static_cast<Position &>(*this) = state.position;
+#else
+  CMove move = state.move;
+  Bitboard moveFrom = move.fromBB();
+  Bitboard moveTo = move.toBB();
+  bool isWhiteMove = blackToMove();
+
+  // Turn the promoted piece back into a pawn, otherwise the piece returns to its square
+  if (move.isPromotion()) {
+    pieceSet(move.promotionPiece(), isWhiteMove) &= ~moveTo;
+    (isWhiteMove ? wPawns : bPawns) |= moveFrom;
+  } else
+    movePiece(pieceSet(state.movedPiece, isWhiteMove), moveTo, moveFrom);
+
+  if (move.isCastling()) {
+    Bitboard &rooks = isWhiteMove ? wRooks : bRooks;
+
+    if (move.flags() == CMove::KING_CASTLE)
+      movePiece(rooks, moveFrom << 1, moveFrom << 3);
+    else
+      movePiece(rooks, moveFrom >> 1, moveFrom >> 4);
   }
 
-  // Handle castling
-  if (king & lastMove.moveFrom)
-    unmakeCastlingMove(rooks, lastMove);
-
-  // Restore the captured piece, if any
-  if (lastMove.capturedPiece)
-    restoreCapturedPiece(lastMove, opponentPawns, opponentKnights, opponentBishops,
-                         opponentRooks, opponentQueens, opponentKing);
-
-  // Handle en passant
-  if (lastMove.wasEnPassant) {
-    Bitboard enPassantCapturedPawn = isWhiteMove ? (lastMove.moveTo >> 8) : (lastMove.moveTo << 8);
-    movePiece(opponentPawns, 0, enPassantCapturedPawn);
-  }
+  if (state.capturedPiece)
+    pieceSet(state.capturedPiece, !isWhiteMove) |= state.capturedSquare;
 
   // Restore previous game state
-  enPassant = lastMove.previousEnPassant;
-  if (isWhiteMove) wCastling = lastMove.previousCastlingRights;
-  else bCastling = lastMove.previousCastlingRights;
-  onTurn = lastMove.previousOnTurn;
+  enPassant = state.enPassant;
+  wCastling = state.wCastling;
+  bCastling = state.bCastling;
+  halfmoveClock = state.halfmoveClock;
+  onTurn *= -1;
+  Position::key = state.key;
+  Position::pawnKey = state.pawnKey;
+  Position::material = state.material;
+  Position::psqt = state.psqt;
+#endif
 
   return true;
 }
 
-bool CBoard::unmakePieceMove(Bitboard &pieceSet, const MoveInfo &lastMove) {
-  if (pieceSet & lastMove.moveTo) {
-    movePiece(pieceSet, lastMove.moveTo, lastMove.moveFrom);
-    return true;
-  }
-  return false;
+void CBoard::makeNullMove() {
+  pushState(CMove());
+
+  if (enPassant)
+    Position::key ^= CZobrist::enPassant(__builtin_ctzll(enPassant) % 8);
+
+  enPassant = 0;
+  halfmoveClock++;
+  onTurn *= -1;
+  Position::key ^= CZobrist::side();
 }
 
-void CBoard::unmakeCastlingMove(Bitboard &rooks, const MoveInfo &lastMove) {
-  if (lastMove.moveTo == lastMove.moveFrom << 2) {
-    // King-side castling
-    movePiece(rooks, lastMove.moveFrom << 1, lastMove.moveFrom << 3);
-  } else if (lastMove.moveTo == lastMove.moveFrom >> 2) {
-    // Queen-side castling
-    movePiece(rooks, lastMove.moveFrom >> 1, lastMove.moveFrom >> 4);
-  }
+void CBoard::unmakeNullMove() {
+  const StateInfo &state = m_states[m_ply--];
+
+  enPassant = state.enPassant;
+  halfmoveClock = state.halfmoveClock;
+  onTurn *= -1;
+  Position::key = state.key;
 }
 
-void CBoard::restoreCapturedPiece(const MoveInfo &lastMove, Bitboard &opponentPawns, Bitboard &opponentKnights,
-                                  Bitboard &opponentBishops, Bitboard &opponentRooks, Bitboard &opponentQueens,
-                                  Bitboard &opponentKing) {
-  switch (lastMove.capturedPieceType) {
-    case 'P':
-      movePiece(opponentPawns, 0, lastMove.capturedPiece);
-      break;
-    case 'N':
-      movePiece(opponentKnights, 0, lastMove.capturedPiece);
-      break;
-    case 'B':
-      movePiece(opponentBishops, 0, lastMove.capturedPiece);
-      break;
-    case 'R':
-      movePiece(opponentRooks, 0, lastMove.capturedPiece);
-      break;
-    case 'Q':
-      movePiece(opponentQueens, 0, lastMove.capturedPiece);
-      break;
-    case 'K':
-      movePiece(opponentKing, 0, lastMove.capturedPiece);
-      break;
-  }
+bool CBoard::hasNonPawnMaterial() const {
+  return whiteToMove() ? (wKnights | wBishops | wRooks | wQueens) != 0 : (bKnights | bBishops | bRooks | bQueens) != 0;
 }
 
 
@@ -819,136 +1111,374 @@ Bitboard CBoard::onMovePositions() const {
   return onTurn == 1 ? white() : black();
 }
 
+
 /*
  ************************************************************
  *                                                          *
- *                      AI Methods                          *
- *                      AI Methods                          *
+ *                         Hashing                          *
+ *                         Hashing                          *
  *                                                          *
  ************************************************************
  */
 
 
-int CBoard::evaluate() {
-  int score = 0;
+uint64_t CBoard::key() const { return Position::key; }
 
-  // Material Count
-  score += PAWN_VALUE * popcount(wPawns);
-  score += KNIGHT_VALUE * popcount(wKnights);
-  score += BISHOP_VALUE * popcount(wBishops);
-  score += ROOK_VALUE * popcount(wRooks);
-  score += QUEEN_VALUE * popcount(wQueens);
-  score += KING_VALUE * popcount(wKing);
-
-  score -= PAWN_VALUE * popcount(bPawns);
-  score -= KNIGHT_VALUE * popcount(bKnights);
-  score -= BISHOP_VALUE * popcount(bBishops);
-  score -= ROOK_VALUE * popcount(bRooks);
-  score -= QUEEN_VALUE * popcount(bQueens);
-  score -= KING_VALUE * popcount(bKing);
-
-  // Positional values
-  score += pieceSquareValue(wPawns, pawnTable);
-  score += pieceSquareValue(wKnights, knightTable);
-  score += pieceSquareValue(wBishops, bishopTable);
-  score += pieceSquareValue(wRooks, rookTable);
-  score += pieceSquareValue(wQueens, queenTable);
-  score += pieceSquareValue(wKing, kingTable);
-
-  score -= pieceSquareValue(bPawns, pawnTable);
-  score -= pieceSquareValue(bKnights, knightTable);
-  score -= pieceSquareValue(bBishops, bishopTable);
-  score -= pieceSquareValue(bRooks, rookTable);
-  score -= pieceSquareValue(bQueens, queenTable);
-  score -= pieceSquareValue(bKing, kingTable);
-
-  // Pawn Structure
-  score += evaluatePawnStructure(wPawns, bPawns);
-  score -= evaluatePawnStructure(bPawns, wPawns);
+uint64_t CBoard::pawnKey() const { return Position::pawnKey; }
 
-  // Mobility
-  score += evaluateMobility(wPawns);
-  score -= evaluateMobility(bPawns);
 
-  return score;
+void CBoard::hashPiece(char pieceType, bool isWhite, Bitboard squares) {
+  int piece = static_cast<int>(std::string_view("PNBRQK").find(pieceType)) + (isWhite ? 0 : 6);
+
+  for (auto square: CBitboardRange(squares)) {
+    uint64_t pieceKey = CZobrist::piece(piece, __builtin_ctzll(square));
+
+    Position::key ^= pieceKey;
+    if (pieceType == 'P')
+      Position::pawnKey ^= pieceKey;
+  }
 }
 
-int CBoard::evaluatePawnStructure(Bitboard pawns, Bitboard opponentPawns) {
-  int score = 0;
 
-  // Doubled Pawns
-  Bitboard doubledPawns = pawns & (pawns >> 8);
-  score -= 50 * popcount(doubledPawns);
+void CBoard::scorePiece(char pieceType, bool isWhite, Bitboard removed, Bitboard added) {
+  int sign = isWhite ? 1 : -1;
+
+  Position::material += sign * pieceScore(pieceType) * (popcount(added) - popcount(removed));
+
+  for (auto square: CBitboardRange(removed))
+    Position::psqt -= sign * pieceSquareValue(pieceType, isWhite, __builtin_ctzll(square));
+
+  for (auto square: CBitboardRange(added))
+    Position::psqt += sign * pieceSquareValue(pieceType, isWhite, __builtin_ctzll(square));
+
+  StateInfo &state = m_states[m_ply];
+  if (state.dirtyCount >= 0)
+    state.dirty[state.dirtyCount++] = {pieceType, isWhite,
+                                       static_cast<int8_t>(removed ? __builtin_ctzll(removed) : -1),
+                                       static_cast<int8_t>(added ? __builtin_ctzll(added) : -1)};
+}
+
+
+int CBoard::castlingIndex() const {
+  return static_cast<int>(((wCastling >> 6) & 1) | ((wCastling >> 2) & 1) << 1 |
+                          ((bCastling >> 62) & 1) << 2 | ((bCastling >> 58) & 1) << 3);
+}
+
+
+uint64_t CBoard::computeKey() const {
+  const Bitboard pieces[12] = {wPawns, wKnights, wBishops, wRooks, wQueens, wKing,
+                               bPawns, bKnights, bBishops, bRooks, bQueens, bKing};
+  uint64_t key = 0;
+
+  for (int piece = 0; piece < 12; ++piece)
+    for (auto square: CBitboardRange(pieces[piece]))
+      key ^= CZobrist::piece(piece, __builtin_ctzll(square));
+
+  key ^= CZobrist::castling(castlingIndex());
 
-  // Blocked Pawns
-  Bitboard blockedPawns = pawns & (opponentPawns >> 8);
-  score -= 30 * popcount(blockedPawns);
+  if (enPassant)
+    key ^= CZobrist::enPassant(__builtin_ctzll(enPassant) % 8);
 
-  // Isolated Pawns
-  Bitboard isolatedPawns = pawns & ~((pawns << 1) | (pawns >> 1));
-  score -= 30 * popcount(isolatedPawns);
+  if (blackToMove())
+    key ^= CZobrist::side();
+
+  return key;
+}
+
+
+uint64_t CBoard::computePawnKey() const {
+  uint64_t key = 0;
+
+  for (auto square: CBitboardRange(wPawns))
+    key ^= CZobrist::piece(0, __builtin_ctzll(square));
+
+  for (auto square: CBitboardRange(bPawns))
+    key ^= CZobrist::piece(6, __builtin_ctzll(square));
+
+  return key;
+}
+
+Score CBoard::computeMaterial() const {
+  return PAWN_SCORE * (popcount(wPawns) - popcount(bPawns)) +
+         KNIGHT_SCORE * (popcount(wKnights) - popcount(bKnights)) +
+         BISHOP_SCORE * (popcount(wBishops) - popcount(bBishops)) +
+         ROOK_SCORE * (popcount(wRooks) - popcount(bRooks)) +
+         QUEEN_SCORE * (popcount(wQueens) - popcount(bQueens));
+}
+
+
+Score CBoard::computePsqt() const {
+  const Bitboard pieces[12] = {wPawns, wKnights, wBishops, wRooks, wQueens, wKing,
+                               bPawns, bKnights, bBishops, bRooks, bQueens, bKing};
+  Score score = 0;
+
+  for (int piece = 0; piece < 12; ++piece)
+    for (auto square: CBitboardRange(pieces[piece])) {
+      bool isWhite = piece < 6;
+      score += (isWhite ? 1 : -1) * pieceSquareValue("PNBRQK"[piece % 6], isWhite, __builtin_ctzll(square));
+    }
 
   return score;
 }
 
-int CBoard::evaluateMobility(Bitboard onMove) {
-  int mobilityScore = 0;
 
+int CBoard::phase() const {
+  int phase = KNIGHT_PHASE * popcount(wKnights | bKnights) + BISHOP_PHASE * popcount(wBishops | bBishops) +
+              ROOK_PHASE * popcount(wRooks | bRooks) + QUEEN_PHASE * popcount(wQueens | bQueens);
+
+  // Promotions can push it over the start
+  return phase < TOTAL_PHASE ? phase : TOTAL_PHASE;
+}
 
-  Bitboard moveFrom = 1ULL;
-  while (moveFrom) {
-    mobilityScore += popcount(legalMoves(moveFrom & onMove));
-    moveFrom <<= 1;
+/*
+ ************************************************************
+ *                                                          *
+ *                      AI Methods                          *
+ *                      AI Methods                          *
+ *                                                          *
+ ************************************************************
+ */
+
+
+int CBoard::evaluate() const {
+  if (CNnue::loaded()) {
+    CNnue::Accumulator accumulator;
+    refreshAccumulator(accumulator.values[0], 0);
+    refreshAccumulator(accumulator.values[1], 1);
+    return evaluateNnue(accumulator);
   }
 
-  return mobilityScore;
+  PawnEntry pawns = {};
+  evaluatePawnStructure(pawns);
+
+  return evaluate(pawns);
 }
 
-int CBoard::popcount(Bitboard bb) {
-  return __builtin_popcountll(bb);
+
+int CBoard::evaluate(CPawnTable &pawnTable, CAccumulatorStack &accumulators) const {
+  if (CNnue::loaded()) {
+    updateAccumulator(accumulators);
+    return evaluateNnue(accumulators[m_ply].accumulator);
+  }
+
+  bool found;
+  PawnEntry &pawns = pawnTable.probe(Position::pawnKey, found);
+
+  if (!found) {
+    evaluatePawnStructure(pawns);
+    pawns.key = Position::pawnKey;
+  }
+
+  return evaluate(pawns);
 }
 
-int CBoard::pieceSquareValue(Bitboard pieces, const int table[64]) {
-  int score = 0;
-  Bitboard moveFrom = 1ULL;
 
-  int index = 0;
-  while (moveFrom) {
-    if (moveFrom & pieces)
-      score += table[index];
+int CBoard::evaluate(const PawnEntry &pawns) const {
+  // Material and positional values are kept up to date by the moves
+  Score score = Position::material + Position::psqt + pawns.score;
 
-    moveFrom <<= 1;
-    index++;
+  // Rooks on files without own pawns
+  for (auto rook: CBitboardRange(wRooks)) {
+    int file = __builtin_ctzll(rook) % 8;
+    if (pawns.openFiles & (1 << file))
+      score += ROOK_OPEN_FILE_BONUS;
+    else if (pawns.wHalfOpenFiles & (1 << file))
+      score += ROOK_HALF_OPEN_FILE_BONUS;
   }
-  return score;
+
+  for (auto rook: CBitboardRange(bRooks)) {
+    int file = __builtin_ctzll(rook) % 8;
+    if (pawns.openFiles & (1 << file))
+      score -= ROOK_OPEN_FILE_BONUS;
+    else if (pawns.bHalfOpenFiles & (1 << file))
+      score -= ROOK_HALF_OPEN_FILE_BONUS;
+  }
+
+  // Knights in the enemy half supported by a pawn, where no enemy pawn can ever chase them away
+  Bitboard wOutposts = (RANK_4 | RANK_5 | RANK_6) & ~pawns.bAttackSpans &
+                       (wPawnEastAttacks(wPawns) | wPawnWestAttacks(wPawns));
+  Bitboard bOutposts = (RANK_3 | RANK_4 | RANK_5) & ~pawns.wAttackSpans &
+                       (bPawnEastAttacks(bPawns) | bPawnWestAttacks(bPawns));
+  score += KNIGHT_OUTPOST_BONUS * (popcount(wKnights & wOutposts) - popcount(bKnights & bOutposts));
+
+  // Mobility
+  score += evaluateMobility(true);
+  score -= evaluateMobility(false);
+
+  // Blend the two values by how much material is left
+  int gamePhase = phase();
+  return (mgValue(score) * gamePhase + egValue(score) * (TOTAL_PHASE - gamePhase)) / TOTAL_PHASE;
 }
 
-std::pair<int, std::pair<Bitboard, Bitboard>> CBoard::negamax(int depth) {
-  if (depth == 0)
-    return {evaluate(), {0, 0}}; // Return evaluation and a dummy move
 
+int CBoard::evaluateNnue(const CNnue::Accumulator &accumulator) const {
+  // The network scores for the side to move
+  int score = CNnue::propagate(accumulator, whiteToMove());
+  return whiteToMove() ? score : -score;
+}
 
-  int maxEval = INT_MIN;
-  std::pair<Bitboard, Bitboard> bestMove = {0, 0};
 
-  Bitboard positions = onMovePositions();
+void CBoard::updateAccumulator(CAccumulatorStack &accumulators) const {
+  int ply = m_ply;
+  accumulators.reserve(ply + 1);
 
-  while (positions) {
-    Bitboard moveFrom = positions & -positions;
-    positions &= positions - 1;
+  CAccumulatorStack::Entry &state = accumulators[ply];
+  if (state.computed && state.key == Position::key)
+    return;
 
-    auto moves = generateMoves(moveFrom);
-    for (const auto &move: moves) {
-      makeMove(move.first, move.second);
-      int eval = -negamax(depth - 1).first;
-      unmakeMove();
+  // Nearest ply of the current line whose accumulator belongs to the position reached there
+  int last = ply - 1;
+  while (last > 0 && !(accumulators[last].computed && accumulators[last].key == keyAt(last)))
+    last--;
 
-      if (eval > maxEval) {
-        maxEval = eval;
-        bestMove = move;
-      }
+  bool lastValid = last >= 0 && accumulators[last].computed && accumulators[last].key == keyAt(last);
+
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    bool isWhite = perspective == 0;
+    int16_t *values = state.accumulator.values[perspective];
+
+    // A king move changes every feature of its side
+    bool refresh = !lastValid;
+    for (int i = last + 1; i <= ply && !refresh; ++i) {
+      refresh = m_states[i].dirtyCount < 0;
+      for (int j = 0; j < m_states[i].dirtyCount; ++j)
+        if (m_states[i].dirty[j].pieceType == 'K' && m_states[i].dirty[j].isWhite == isWhite)
+          refresh = true;
+    }
+
+    if (refresh) {
+      refreshAccumulator(values, perspective);
+      continue;
     }
+
+    int kingSquare = __builtin_ctzll(isWhite ? wKing : bKing);
+    std::copy_n(accumulators[last].accumulator.values[perspective], CNnue::HALF_DIMENSIONS, values);
+
+    for (int i = last + 1; i <= ply; ++i)
+      for (int j = 0; j < m_states[i].dirtyCount; ++j) {
+        const DirtyPiece &piece = m_states[i].dirty[j];
+        if (piece.pieceType == 'K')
+          continue;
+
+        if (piece.from >= 0)
+          CNnue::removeFeature(values, CNnue::featureIndex(perspective, kingSquare, piece.pieceType, piece.isWhite,
+                                                           piece.from));
+        if (piece.to >= 0)
+          CNnue::addFeature(values, CNnue::featureIndex(perspective, kingSquare, piece.pieceType, piece.isWhite,
+                                                        piece.to));
+      }
+  }
+
+  state.key = Position::key;
+  state.computed = true;
+}
+
+
+void CBoard::refreshAccumulator(int16_t *accumulator, int perspective) const {
+  const Bitboard pieces[10] = {wPawns, wKnights, wBishops, wRooks, wQueens,
+                               bPawns, bKnights, bBishops, bRooks, bQueens};
+  int kingSquare = __builtin_ctzll(perspective == 0 ? wKing : bKing);
+
+  CNnue::initAccumulator(accumulator);
+
+  for (int piece = 0; piece < 10; ++piece)
+    for (auto square: CBitboardRange(pieces[piece]))
+      CNnue::addFeature(accumulator, CNnue::featureIndex(perspective, kingSquare, "PNBRQ"[piece % 5], piece < 5,
+                                                         __builtin_ctzll(square)));
+}
+
+
+void CBoard::evaluatePawnStructure(PawnEntry &entry) const {
+  Bitboard wFiles = fileFill(wPawns);
+  Bitboard bFiles = fileFill(bPawns);
+
+  // Squares in front of the pawns, on their own and the neighbouring files
+  Bitboard wFront = nortFill(nortOne(wPawns));
+  Bitboard bFront = soutFill(soutOne(bPawns));
+
+  entry.wAttackSpans = westOne(wFront) | eastOne(wFront);
+  entry.bAttackSpans = westOne(bFront) | eastOne(bFront);
+  entry.wPassed = wPawns & ~(bFront | entry.bAttackSpans);
+  entry.bPassed = bPawns & ~(wFront | entry.wAttackSpans);
+
+  entry.openFiles = static_cast<uint8_t>(~(wFiles | bFiles) & RANK_1);
+  entry.wHalfOpenFiles = static_cast<uint8_t>(~wFiles & bFiles & RANK_1);
+  entry.bHalfOpenFiles = static_cast<uint8_t>(wFiles & ~bFiles & RANK_1);
+
+  Score score = 0;
+
+  // Doubled pawns, counting those with another pawn of the side behind them
+  score -= DOUBLED_PAWN_PENALTY * (popcount(wPawns & nortOne(nortFill(wPawns))) -
+                                   popcount(bPawns & soutOne(soutFill(bPawns))));
+
+  // Isolated pawns, no pawns of the side on the neighbouring files
+  score -= ISOLATED_PAWN_PENALTY * (popcount(wPawns & ~(westOne(wFiles) | eastOne(wFiles))) -
+                                    popcount(bPawns & ~(westOne(bFiles) | eastOne(bFiles))));
+
+  // Blocked pawns, an enemy pawn right in front
+  score -= BLOCKED_PAWN_PENALTY * (popcount(wPawns & soutOne(bPawns)) - popcount(bPawns & nortOne(wPawns)));
+
+  for (auto pawn: CBitboardRange(entry.wPassed))
+    score += passedPawnBonus[__builtin_ctzll(pawn) / 8];
+
+  for (auto pawn: CBitboardRange(entry.bPassed))
+    score -= passedPawnBonus[7 - __builtin_ctzll(pawn) / 8];
+
+  entry.score = score;
+}
+
+
+Score CBoard::evaluateMobility(bool isWhite) const {
+  Bitboard occupied = white() | black();
+  Bitboard enemyPawnAttacks = isWhite ? bPawnEastAttacks(bPawns) | bPawnWestAttacks(bPawns)
+                                      : wPawnEastAttacks(wPawns) | wPawnWestAttacks(wPawns);
+  Bitboard area = ~(isWhite ? wPawns | wKing : bPawns | bKing) & ~enemyPawnAttacks;
+  int score = 0;
+
+  for (auto piece: CBitboardRange(isWhite ? wKnights : bKnights))
+    score += knightMobility[popcount(knightAttacks(piece) & area)];
+
+  for (auto piece: CBitboardRange(isWhite ? wBishops : bBishops))
+    score += bishopMobility[popcount(CAttacks::bishopAttacks(__builtin_ctzll(piece), occupied) & area)];
+
+  for (auto piece: CBitboardRange(isWhite ? wRooks : bRooks))
+    score += rookMobility[popcount(CAttacks::rookAttacks(__builtin_ctzll(piece), occupied) & area)];
+
+  for (auto piece: CBitboardRange(isWhite ? wQueens : bQueens))
+    score += queenMobility[popcount(CAttacks::queenAttacks(__builtin_ctzll(piece), occupied) & area)];
+
+  // Worth the same in both phases
+  return makeScore(score, score);
+}
+
+int CBoard::popcount(Bitboard bb) {
+  return __builtin_popcountll(bb);
+}
+
+Score CBoard::pieceSquareValue(char pieceType, bool isWhite, int square) {
+  if (!isWhite)
+    square ^= 56;
+
+  // Only the pawns and the king change their preferred squares in the endgame
+  switch (pieceType) {
+    case 'P': return makeScore(pawnTable[square], pawnEndgameTable[square]);
+    case 'N': return makeScore(knightTable[square], knightTable[square]);
+    case 'B': return makeScore(bishopTable[square], bishopTable[square]);
+    case 'R': return makeScore(rookTable[square], rookTable[square]);
+    case 'Q': return makeScore(queenTable[square], queenTable[square]);
+    case 'K': return makeScore(kingTable[square], kingEndgameTable[square]);
+    default:  return 0;
   }
+}
 
-  return {maxEval, bestMove};
+
+Score CBoard::pieceScore(char pieceType) {
+  switch (pieceType) {
+    case 'P': return PAWN_SCORE;
+    case 'N': return KNIGHT_SCORE;
+    case 'B': return BISHOP_SCORE;
+    case 'R': return ROOK_SCORE;
+    case 'Q': return QUEEN_SCORE;
+    default:  return 0;  // Kings are never captured
+  }
 }
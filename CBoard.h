@@ -6,66 +6,73 @@
 #define SFML_CHESS_CBOARD_H
 
 
-#include <SFML/Graphics.hpp>
 #include <iostream>
 #include <bitset>
-#include <stack>
 #include <cstdint>
+#include <string>
+#include <vector>
 #include "CBitboardIterator.h"
-
-
-#define TILE    70
-#define WIDTH   (8 * TILE) // 8 because We have 8 rectangles here
-#define HEIGHT  WIDTH
-#define BORDER  1
-
-typedef uint64_t Bitboard;
-
-
-
-class CBoard {
+#include "CAttacks.h"
+#include "CMove.h"
+#include "CNnue.h"
+#include "CPawnTable.h"
+#include "CPosition.h"
+#include "CScore.h"
+#include "CZobrist.h"
+
+
+// The position itself is the Position base, private so that only the board changes it, and readable through
+// position()
+class CBoard : private Position {
 private:
 
-  struct MoveInfo {
-    Bitboard moveFrom;
-    Bitboard moveTo;
-    Bitboard capturedPiece;
-    Bitboard previousEnPassant;
-    Bitboard previousCastlingRights;
-    int previousOnTurn;
-    bool wasEnPassant;
-    char capturedPieceType; // Store type of captured piece ('P', 'N', 'B', 'R', 'Q', 'K')
-    Bitboard isPromotion;
-    Bitboard *promotedTo;
+  // Piece that changed squares on the way to a ply, -1 for the side it came from or went to nowhere
+  struct DirtyPiece {
+    char pieceType;
+    bool isWhite;
+    int8_t from;
+    int8_t to;
   };
 
+  // What a move cannot restore by itself, kept by value for every ply so that unmaking it is a few stores
+  struct StateInfo {
+    CMove move;                // Null move for makeNullMove
+    char movedPiece;
+    char capturedPiece;        // 0 if nothing was captured
+    Bitboard capturedSquare;   // Differs from the target square for en passant
+    Bitboard enPassant;
+    Bitboard wCastling;
+    Bitboard bCastling;
+    int halfmoveClock;
+    uint64_t key;
+    uint64_t pawnKey;
+    Score material;
+    Score psqt;
+    // Moves only note which pieces changed, the network accumulator of the ply is brought up to date from them when
+    // the position is evaluated
+    int dirtyCount;            // -1 when no network was loaded to note them
+    DirtyPiece dirty[4];       // Captured piece, moved piece and the two halves of a promotion, or king and rook
+#ifdef COPY_MAKE
+    Position position;         // The whole position before the move, unmaking copies it back
+#endif
+  };
 
+  // Indexed by ply, m_states[m_ply] belongs to the last move made. Grows in large steps and is never shrunk, so
+  // making a move allocates nothing once the search is running.
+  std::vector<StateInfo> m_states;
+  int m_ply;
 
-  // Create piece bitboards
-  Bitboard wPawns, wKnights, wBishops, wRooks, wQueens, wKing;
-  Bitboard bPawns, bKnights, bBishops, bRooks, bQueens, bKing;
-
-  Bitboard wCastling;
-  Bitboard bCastling;
-
-  Bitboard enPassant;
-
-  int onTurn;
-
-  std::stack<MoveInfo> m_moveList;
-
-  // Colors for the palette
-  mutable sf::Color lightSquareColor; // Just for drawing -> mutable
-  mutable sf::Color darkSquareColor; // Just for drawing -> mutable
-  mutable sf::Color borderColor; // Just for drawing -> mutable
-  mutable sf::Color highlightSrcColor; // Just for drawing -> mutable
-  mutable sf::Color highlightDstColor; // Just for drawing -> mutable
+  // Plies played before the position the board was loaded from, only for the fullmove number of the FEN
+  int m_startPly;
 
-  // Create an array to store sprites
-  mutable sf::Sprite m_sprites[12];     // Just for drawing -> mutable
-  mutable sf::Texture m_textures[12];     // Just for drawing -> mutable
-  mutable sf::RectangleShape m_rectangle; // Just for drawing -> mutable
 
+  // Computed once per position before generating legal moves
+  struct CheckInfo {
+    Bitboard checkers;    // Enemy pieces giving check to the king
+    Bitboard pinned;      // Own pieces pinned to the king, they may move only along the pin ray
+    Bitboard checkMask;   // Target squares of non-king moves that resolve the check, all squares if not in check
+    Bitboard kingDanger;  // Squares attacked by the enemy with the king removed from the board
+  };
 
 
 
@@ -116,12 +123,12 @@ private:
  */
 
 
-  const int PAWN_VALUE = 100;
-  const int KNIGHT_VALUE = 320;
-  const int BISHOP_VALUE = 330;
-  const int ROOK_VALUE = 500;
-  const int QUEEN_VALUE = 900;
-  const int KING_VALUE = 20000;
+  static constexpr int PAWN_VALUE = 100;
+  static constexpr int KNIGHT_VALUE = 320;
+  static constexpr int BISHOP_VALUE = 330;
+  static constexpr int ROOK_VALUE = 500;
+  static constexpr int QUEEN_VALUE = 900;
+  static constexpr int KING_VALUE = 20000;
 
   // Piece-square tables for evaluating positions
   static constexpr int pawnTable[64] = {
@@ -201,6 +208,55 @@ private:
           -50, -30, -30, -30, -30, -30, -30, -50
   };
 
+  static constexpr int pawnEndgameTable[64] = {
+          0, 0, 0, 0, 0, 0, 0, 0,
+          10, 10, 10, 10, 10, 10, 10, 10,
+          10, 10, 10, 10, 10, 10, 10, 10,
+          20, 20, 20, 20, 20, 20, 20, 20,
+          35, 35, 35, 35, 35, 35, 35, 35,
+          55, 55, 55, 55, 55, 55, 55, 55,
+          80, 80, 80, 80, 80, 80, 80, 80,
+          0, 0, 0, 0, 0, 0, 0, 0
+  };
+
+  // Material for the tapered evaluation, the plain values above stay for exchanges and move ordering
+  static constexpr Score PAWN_SCORE = makeScore(100, 120);
+  static constexpr Score KNIGHT_SCORE = makeScore(320, 300);
+  static constexpr Score BISHOP_SCORE = makeScore(330, 320);
+  static constexpr Score ROOK_SCORE = makeScore(500, 530);
+  static constexpr Score QUEEN_SCORE = makeScore(900, 950);
+
+  // Game phase from the non-pawn material, 24 with all pieces on the board and 0 in a pawn endgame
+  static constexpr int KNIGHT_PHASE = 1;
+  static constexpr int BISHOP_PHASE = 1;
+  static constexpr int ROOK_PHASE = 2;
+  static constexpr int QUEEN_PHASE = 4;
+  static constexpr int TOTAL_PHASE = 24;
+
+  // Mobility bonus indexed by the number of safe squares a piece attacks
+  static constexpr int knightMobility[9] = {-25, -11, -4, 0, 4, 8, 12, 15, 17};
+
+  static constexpr int bishopMobility[14] = {-24, -12, -4, 2, 7, 12, 16, 20, 22, 24, 26, 28, 29, 30};
+
+  static constexpr int rookMobility[15] = {-15, -8, -4, -1, 1, 3, 5, 8, 10, 12, 14, 16, 17, 18, 19};
+
+  static constexpr int queenMobility[28] = {-15, -10, -6, -4, -2, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 12, 13,
+                                            13, 14, 14, 15, 15, 16, 16, 16};
+
+  // Pawn structure
+  static constexpr Score DOUBLED_PAWN_PENALTY = makeScore(10, 25);
+  static constexpr Score ISOLATED_PAWN_PENALTY = makeScore(15, 15);
+  static constexpr Score BLOCKED_PAWN_PENALTY = makeScore(10, 10);
+
+  // Passed pawn bonus by rank counted from the side's own first rank
+  static constexpr Score passedPawnBonus[8] = {0, makeScore(5, 10), makeScore(10, 15), makeScore(15, 30),
+                                               makeScore(25, 50), makeScore(40, 80), makeScore(60, 120), 0};
+
+  // Terms built on the cached pawn entry
+  static constexpr Score ROOK_OPEN_FILE_BONUS = makeScore(25, 10);
+  static constexpr Score ROOK_HALF_OPEN_FILE_BONUS = makeScore(12, 5);
+  static constexpr Score KNIGHT_OUTPOST_BONUS = makeScore(20, 10);
+
 
 
 /*
@@ -212,11 +268,6 @@ private:
  ************************************************************
  */
 
-  void removeCapturedWhite(Bitboard pos, Bitboard &removedFrom, char &pieceType);
-
-  void removeCapturedBlack(Bitboard moveTo, Bitboard &removedFrom, char &pieceType);
-
-
   inline static Bitboard nortOne(Bitboard pos) { return pos << 8; }
 
   inline static Bitboard soutOne(Bitboard pos) { return pos >> 8; }
@@ -244,6 +295,23 @@ private:
   inline static Bitboard soEa(Bitboard pos) { return soutOne(eastOne(pos)); }
 
 
+  // Every square on the way to the board edge, including the starting ones
+  inline static Bitboard nortFill(Bitboard pos) {
+    pos |= pos << 8;
+    pos |= pos << 16;
+    return pos | pos << 32;
+  }
+
+  inline static Bitboard soutFill(Bitboard pos) {
+    pos |= pos >> 8;
+    pos |= pos >> 16;
+    return pos | pos >> 32;
+  }
+
+  // Whole files of the given squares
+  inline static Bitboard fileFill(Bitboard pos) { return nortFill(pos) | soutFill(pos); }
+
+
 /*
  ************************************************************
  *                                                          *
@@ -300,6 +368,10 @@ private:
 
   inline static Bitboard noNoWe(Bitboard pos) { return (pos & NOT_FILE_A) << 15; }
 
+  inline static Bitboard knightAttacks(Bitboard pos) {
+    return noNoEa(pos) | noEaEa(pos) | soEaEa(pos) | soSoEa(pos) | soSoWe(pos) | soWeWe(pos) | noWeWe(pos) | noNoWe(pos);
+  }
+
   Bitboard wKnightMoves(Bitboard pos) const;
 
   Bitboard bKnightMoves(Bitboard pos) const;
@@ -313,8 +385,6 @@ private:
  ************************************************************
  */
 
-  static Bitboard sliderMoves(Bitboard pos, Bitboard (*directionFunc)(Bitboard), Bitboard enemies, Bitboard empty);
-
   static Bitboard bishopMoves(Bitboard pos, Bitboard enemies, Bitboard empty);
 
   Bitboard wBishopMoves(Bitboard pos) const;
@@ -345,6 +415,8 @@ private:
  ************************************************************
  */
 
+  static Bitboard queenMoves(Bitboard pos, Bitboard enemies, Bitboard empty);
+
   Bitboard wQueenMoves(Bitboard pos) const;
 
   Bitboard bQueenMoves(Bitboard pos) const;
@@ -360,6 +432,13 @@ private:
 
   inline static Bitboard oneAround(Bitboard pos);
 
+  Bitboard wAttacks(Bitboard occupied) const;
+
+  Bitboard bAttacks(Bitboard occupied) const;
+
+  // Pieces of both colors attacking the square, sliders see through the squares missing in occupied
+  Bitboard attackersTo(int square, Bitboard occupied) const;
+
   Bitboard wKingSafe(Bitboard pos) const;
 
   Bitboard bKingSafe(Bitboard pos) const;
@@ -368,6 +447,25 @@ private:
 
   Bitboard bKingMoves(Bitboard pos) const;
 
+/*
+ ************************************************************
+ *                                                          *
+ *                   Legal move generation                  *
+ *                   Legal move generation                  *
+ *                                                          *
+ ************************************************************
+ */
+
+  CheckInfo checkInfo() const;
+
+  Bitboard kingTargets(Bitboard king, const CheckInfo &info) const;
+
+  bool isEnPassantLegal(Bitboard moveFrom, const CheckInfo &info) const;
+
+  Bitboard legalTargets(Bitboard moveFrom, const CheckInfo &info) const;
+
+  void addMoves(Bitboard moveFrom, Bitboard targets, CMoveList &moves) const;
+
   /*
  ************************************************************
  *                                                          *
@@ -379,6 +477,28 @@ private:
 
   static bool movePiece(Bitboard &pieces, Bitboard moveFrom, Bitboard moveTo);
 
+  int castlingIndex() const;
+
+  void hashPiece(char pieceType, bool isWhite, Bitboard squares);
+
+  // Everything but the pawn structure, which comes in the entry
+  int evaluate(const PawnEntry &pawns) const;
+
+  // Updates the material and piece-square scores for a piece leaving the removed squares and entering the added ones,
+  // and notes the change for the network accumulator
+  void scorePiece(char pieceType, bool isWhite, Bitboard removed, Bitboard added);
+
+  // Key of the position the given ply of the current line reached
+  uint64_t keyAt(int ply) const { return ply == m_ply ? Position::key : m_states[ply + 1].key; }
+
+  // Brings the accumulator of the current ply up to date from the nearest ply computed before
+  void updateAccumulator(CAccumulatorStack &accumulators) const;
+
+  // Sum of all features seen from one side, needed at the root and whenever that side's king moves
+  void refreshAccumulator(int16_t *accumulator, int perspective) const;
+
+  int evaluateNnue(const CNnue::Accumulator &accumulator) const;
+
   template<bool isWhite>
   constexpr Bitboard enemyOrEmpty() const {
     if constexpr (isWhite)
@@ -387,41 +507,45 @@ private:
   }
 
 
-  static bool handleRookMove(Bitboard& rooks, Bitboard moveFrom, Bitboard moveTo, Bitboard& castlingRights);
-
-  bool handleKingMove(Bitboard& king, Bitboard& rooks, Bitboard moveFrom, Bitboard moveTo, Bitboard& castlingRights) const;
+  void updateCastlingRights(Bitboard moveFrom, Bitboard moveTo);
 
-  bool handlePawnMove(Bitboard& pawns, Bitboard moveFrom, Bitboard moveTo, bool& enPassantSet, MoveInfo& moveInfo);
+  // Saves the irreversible state of the position into the next ply before a move changes it
+  StateInfo &pushState(CMove move);
 
-  static bool movePieceIfValid(Bitboard& pieceSet, Bitboard moveFrom, Bitboard moveTo);
+  void handleCapture(CMove move, StateInfo &state);
 
-  static bool unmakePieceMove(Bitboard &pieceSet, const MoveInfo &lastMove);
+  void handleCastling(CMove move);
 
-  static void unmakeCastlingMove(Bitboard &rooks, const MoveInfo &lastMove);
+  void handlePromotion(Bitboard moveTo, char promotedPiece);
 
-  static void restoreCapturedPiece(const MoveInfo &lastMove, Bitboard &opponentPawns, Bitboard &opponentKnights,
-                            Bitboard &opponentBishops, Bitboard &opponentRooks, Bitboard &opponentQueens, Bitboard &opponentKing);
+  // Bitboard of one type and colour to be changed by a move
+  Bitboard &pieceSet(char pieceType, bool isWhite);
 
 
 public:
-  explicit CBoard();
+  // Parts of the move list, so the search can generate captures and quiet moves separately
+  enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES,  // Captures, en passant and all promotions
+    GEN_QUIETS,    // Everything else
+  };
 
-  bool loadTextures(const std::string texturePath[12]) const;
+  explicit CBoard();
 
-  void draw(sf::RenderWindow &window, Bitboard moveFrom);
+  bool loadFen(const std::string &fen);
 
-  static char showPromotionWindow();
+  // Complete FEN with the halfmove clock and the fullmove number, loadFen reads it back unchanged
+  std::string toFen() const;
 
-  Bitboard isPromotion() const;
+  const Position &position() const { return *this; }
 
-  void handlePromotion(char promotionPiece);
+  // Starts from a position copied out of another board, without its move history
+  void setPosition(const Position &position);
 
   bool whiteToMove() const;
 
   bool blackToMove() const;
 
-  void handleCapture(Bitboard moveTo, MoveInfo& moveInfo);
-
   inline Bitboard white() const;
 
   inline Bitboard black() const;
@@ -430,31 +554,92 @@ public:
 
   int pieceCount() const;
 
-  bool makeMove(Bitboard moveFrom, Bitboard moveTo);
+  bool makeMove(CMove move);
 
   bool unmakeMove();
 
+  // Passes the turn without moving, for null move pruning; not allowed in check
+  void makeNullMove();
+
+  void unmakeNullMove();
+
+  // Knights, bishops, rooks or queens of the side to move, without them null move pruning fails in zugzwang
+  bool hasNonPawnMaterial() const;
+
   Bitboard pseudoLegalMoves(Bitboard pos) const;
 
-  Bitboard legalMoves(Bitboard pos);
+  Bitboard legalMoves(Bitboard pos) const;
+
+  bool isMoveLegal(Bitboard from, Bitboard to) const;
+
+  // Check for moves coming from outside the generator (hash table, killers)
+  bool isMoveLegal(CMove move) const;
 
-  bool isMoveLegal(Bitboard from, Bitboard to);
+  // Piece type on the square regardless of color, 0 if empty
+  char pieceAt(int square) const;
+
+  bool inCheck() const;
+
+  // Fifty moves without a capture or pawn move, or a position seen before since the last one. A single repetition is
+  // enough, the search would just repeat it again.
+  bool isDraw() const;
 
   Bitboard onMovePositions() const;
 
-  std::vector<std::pair<Bitboard, Bitboard>> generateMoves(Bitboard moveFrom);
+  uint64_t key() const;
 
-  int evaluate();
+  uint64_t pawnKey() const;
 
-  static int pieceSquareValue(Bitboard pieces, const int table[64]);
+  uint64_t computeKey() const;
 
-  static int evaluatePawnStructure(Bitboard pawns, Bitboard opponentPawns);
+  uint64_t computePawnKey() const;
 
-  int evaluateMobility(Bitboard onMove);
+  // Pieces of one type and colour
+  Bitboard pieces(char pieceType, bool isWhite) const;
 
-  static int popcount(Bitboard bb);
+  bool hasCastlingRights() const { return (wCastling | bCastling) != 0; }
+
+  Score material() const { return Position::material; }
+
+  Score psqt() const { return Position::psqt; }
+
+  Score computeMaterial() const;
+
+  Score computePsqt() const;
+
+  // Non-pawn material of both sides in phase units, TOTAL_PHASE at the start
+  int phase() const;
+
+  void generateMoves(CMoveList &moves, GenType type = GEN_ALL) const;
 
-  std::pair<int, std::pair<Bitboard, Bitboard>> negamax(int depth);
+  CMove findMove(Bitboard from, Bitboard to, char promotion = 'Q') const;
+
+  static int pieceValue(char pieceType);
+
+  // Material won or lost by the exchange sequence the move starts on its target square
+  int see(CMove move) const;
+
+  // Network evaluation once CNnue::load succeeded, the handcrafted one otherwise. Without an accumulator stack the
+  // network sums all features from scratch.
+  int evaluate() const;
+
+  // Same evaluation, with the pawn structure taken from the table when these pawns were seen before and the network
+  // accumulator updated incrementally from the stack of the search
+  int evaluate(CPawnTable &pawnTable, CAccumulatorStack &accumulators) const;
+
+  void evaluatePawnStructure(PawnEntry &entry) const;
+
+  // Tables are written for white, black uses the square mirrored to its side of the board
+  static Score pieceSquareValue(char pieceType, bool isWhite, int square);
+
+  static Score pieceScore(char pieceType);
+
+
+  // Attacked squares of knights, bishops, rooks and queens, not counting own pawns and king or squares covered by
+  // enemy pawns
+  Score evaluateMobility(bool isWhite) const;
+
+  static int popcount(Bitboard bb);
 };
 
 #endif //SFML_CHESS_CBOARD_H
\ No newline at end of file
@@ -0,0 +1,233 @@
+//
+// Created by Petr Smerda on 07.10.2024.
+//
+
+#include "CBoardRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+bool CBoardRenderer::loadTextures(const std::string texturePath[12]) {
+
+  for (int i = 0; i < 12; ++i) {
+    if (!m_textures[i].loadFromFile(texturePath[i])) {
+      std::cerr << "Failed to load texture: " << texturePath[i] << std::endl;
+      return false;
+    }
+
+    // Assign and scale the textures to sprites
+    m_sprites[i].setTexture(m_textures[i]);
+    sf::Vector2u textureSize = m_textures[i].getSize();
+
+    // Calculate the scale factor to fit within tileSize
+    float scaleFactor = static_cast<float>(TILE) / static_cast<float>(std::max(textureSize.x, textureSize.y));
+    m_sprites[i].setScale(scaleFactor, scaleFactor);
+  }
+
+  lightSquareColor = sf::Color(240, 248, 255);  // Alice blue
+  darkSquareColor = sf::Color(70, 130, 180);    // Steel blue
+  borderColor = sf::Color(60, 100, 150);        // Deep blue
+  highlightSrcColor = sf::Color(0, 191, 255);   // Deep sky blue
+  highlightDstColor = sf::Color(30, 144, 255);  // Dodger blue
+
+
+  m_rectangle = sf::RectangleShape(sf::Vector2f(TILE - BORDER * 2, TILE - BORDER * 2));
+  m_rectangle.setOutlineColor(borderColor);
+  m_rectangle.setOutlineThickness(BORDER);
+
+  return true;
+}
+
+
+void CBoardRenderer::draw(sf::RenderWindow &window, const CBoard &board, Bitboard moveFrom) {
+
+  // Drawing the board and squares
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
+      m_rectangle.setFillColor((x + y) % 2 == 0 ? lightSquareColor : darkSquareColor);
+      window.draw(m_rectangle);
+    }
+  }
+
+  // Drawing the selected square, if any
+  if (moveFrom) {
+    int pos = __builtin_ctzll(moveFrom); // Extracting the set bit to draw it on the board
+
+    int x = pos % 8;
+    int y = 7 - (pos / 8);
+
+    m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
+    m_rectangle.setFillColor(highlightSrcColor);
+    window.draw(m_rectangle);
+  }
+
+  // Highlighting possible moves
+  Bitboard possibleMoves = board.legalMoves(moveFrom);
+  for (int square = 0; square < 64; ++square) {
+    if (possibleMoves & (1ULL << square)) {
+      int x = square % 8;
+      int y = 7 - (square / 8);
+
+      m_rectangle.setPosition(static_cast<float>(x * TILE + BORDER), static_cast<float>(y * TILE + BORDER));
+      m_rectangle.setFillColor(highlightDstColor); // Highlight color for possible moves
+      window.draw(m_rectangle);
+    }
+  }
+
+  // Function to position pieces based on bitboard
+  auto posFromBitboard = [&](sf::Sprite &sprite, Bitboard bitboard) {
+    for (int square = 0; square < 64; ++square) {
+      if (bitboard & (1ULL << square)) {
+        int rank = square / 8;
+        int file = square % 8;
+
+        // Here I need to reverse the positions -> 7 - rank
+        sprite.setPosition(static_cast<float>(file) * TILE, static_cast<float>(7 - rank) * TILE);
+
+        window.draw(sprite);
+      }
+    }
+  };
+
+  // Draw the pieces
+  const Position &position = board.position();
+
+  posFromBitboard(m_sprites[0], position.wPawns);
+  posFromBitboard(m_sprites[1], position.wKing);
+  posFromBitboard(m_sprites[2], position.wKnights);
+  posFromBitboard(m_sprites[3], position.wBishops);
+  posFromBitboard(m_sprites[4], position.wQueens);
+  posFromBitboard(m_sprites[5], position.wRooks);
+
+  posFromBitboard(m_sprites[6], position.bPawns);
+  posFromBitboard(m_sprites[7], position.bKing);
+  posFromBitboard(m_sprites[8], position.bKnights);
+  posFromBitboard(m_sprites[9], position.bBishops);
+  posFromBitboard(m_sprites[10], position.bQueens);
+  posFromBitboard(m_sprites[11], position.bRooks);
+}
+
+
+void CBoardRenderer::drawEvalBar(sf::RenderWindow &window, int whiteScore, bool mate) {
+  float whiteShare = mate ? (whiteScore > 0 ? 1.0f : 0.0f)
+                          : 1.0f / (1.0f + std::exp(-static_cast<float>(whiteScore) / 250.0f));
+
+  sf::RectangleShape bar(sf::Vector2f(EVAL_BAR_WIDTH, HEIGHT));
+  bar.setPosition(WIDTH, 0);
+  bar.setFillColor(sf::Color(40, 40, 40));
+  window.draw(bar);
+
+  // White is at the bottom like on the board
+  float whiteHeight = whiteShare * HEIGHT;
+  bar.setSize(sf::Vector2f(EVAL_BAR_WIDTH, whiteHeight));
+  bar.setPosition(WIDTH, HEIGHT - whiteHeight);
+  bar.setFillColor(lightSquareColor);
+  window.draw(bar);
+}
+
+
+void CBoardRenderer::drawArrow(sf::RenderWindow &window, CMove move) {
+  if (!move)
+    return;
+
+  auto center = [](int square) {
+    return sf::Vector2f((static_cast<float>(square % 8) + 0.5f) * TILE, (7.5f - static_cast<float>(square / 8)) * TILE);
+  };
+
+  sf::Vector2f from = center(move.from());
+  sf::Vector2f to = center(move.to());
+  sf::Vector2f direction = to - from;
+
+  float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+  float angle = std::atan2(direction.y, direction.x) * 180.0f / 3.14159265f;
+  float headLength = TILE * 0.4f;
+  sf::Color color(255, 140, 0, 180);  // Dark orange
+
+  sf::RectangleShape shaft(sf::Vector2f(std::max(length - headLength, 0.0f), TILE * 0.15f));
+  shaft.setOrigin(0, TILE * 0.075f);
+  shaft.setPosition(from);
+  shaft.setRotation(angle);
+  shaft.setFillColor(color);
+  window.draw(shaft);
+
+  sf::ConvexShape head(3);
+  head.setPoint(0, sf::Vector2f(0, -TILE * 0.2f));
+  head.setPoint(1, sf::Vector2f(headLength, 0));
+  head.setPoint(2, sf::Vector2f(0, TILE * 0.2f));
+  head.setPosition(from + direction * (std::max(length - headLength, 0.0f) / length));
+  head.setRotation(angle);
+  head.setFillColor(color);
+  window.draw(head);
+}
+
+
+char CBoardRenderer::showPromotionWindow() {
+  sf::RenderWindow promotionWindow(sf::VideoMode(400, 100), "Pawn Promotion");
+
+  sf::Font font;
+  if (!font.loadFromFile("/System/Library/Fonts/Supplemental/Arial.ttf")) {
+    std::cerr << "Error loading font\n";
+    std::cout << "font cannot be loaded" << std::endl;
+    return 'Q';  // Default to Queen if font fails to load
+  }
+
+  // Creating text objects for promotion options
+  sf::Text queenText("Q - Queen", font, 20);
+  sf::Text rookText("R - Rook", font, 20);
+  sf::Text bishopText("B - Bishop", font, 20);
+  sf::Text knightText("N - Knight", font, 20);
+
+  queenText.setPosition(20, 5);
+  rookText.setPosition(20, 25);
+  bishopText.setPosition(20, 45);
+  knightText.setPosition(20, 65);
+
+  queenText.setFillColor(sf::Color::Black);
+  rookText.setFillColor(sf::Color::Black);
+  bishopText.setFillColor(sf::Color::Black);
+  knightText.setFillColor(sf::Color::Black);
+
+  char chosenPiece = 'Q';  // Default promotion to Queen
+
+  while (promotionWindow.isOpen()) {
+    sf::Event event = sf::Event();
+    while (promotionWindow.pollEvent(event)) {
+      if (event.type == sf::Event::Closed)
+        promotionWindow.close();
+
+      if (event.type == sf::Event::KeyPressed) {
+        switch (event.key.code) {
+          case sf::Keyboard::Q:
+            chosenPiece = 'Q';
+            promotionWindow.close();
+            break;
+          case sf::Keyboard::R:
+            chosenPiece = 'R';
+            promotionWindow.close();
+            break;
+          case sf::Keyboard::B:
+            chosenPiece = 'B';
+            promotionWindow.close();
+            break;
+          case sf::Keyboard::N:
+            chosenPiece = 'N';
+            promotionWindow.close();
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+    promotionWindow.clear(sf::Color::White);
+    promotionWindow.draw(queenText);
+    promotionWindow.draw(rookText);
+    promotionWindow.draw(bishopText);
+    promotionWindow.draw(knightText);
+    promotionWindow.display();
+  }
+
+  return chosenPiece;
+}
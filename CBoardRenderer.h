@@ -0,0 +1,51 @@
+//
+// Created by Petr Smerda on 07.10.2024.
+//
+
+#ifndef SFML_CHESS_CBOARDRENDERER_H
+#define SFML_CHESS_CBOARDRENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <string>
+#include "CBoard.h"
+#include "CMove.h"
+
+
+#define TILE    70
+#define WIDTH   (8 * TILE) // 8 because We have 8 rectangles here
+#define HEIGHT  WIDTH
+#define BORDER  1
+#define EVAL_BAR_WIDTH  24  // Right of the board
+
+
+// Draws a board into an SFML window. It only reads the board, so the engine itself builds without SFML.
+class CBoardRenderer {
+public:
+  bool loadTextures(const std::string texturePath[12]);
+
+  void draw(sf::RenderWindow &window, const CBoard &board, Bitboard moveFrom);
+
+  // White's share of the bar grows with the score from white's point of view, a mate fills it completely
+  void drawEvalBar(sf::RenderWindow &window, int whiteScore, bool mate);
+
+  // Arrow over the board from the origin to the target square of the move
+  void drawArrow(sf::RenderWindow &window, CMove move);
+
+  static char showPromotionWindow();
+
+private:
+  // Colors for the palette
+  sf::Color lightSquareColor;
+  sf::Color darkSquareColor;
+  sf::Color borderColor;
+  sf::Color highlightSrcColor;
+  sf::Color highlightDstColor;
+
+  // Create an array to store sprites
+  sf::Sprite m_sprites[12];
+  sf::Texture m_textures[12];
+  sf::RectangleShape m_rectangle;
+};
+
+
+#endif //SFML_CHESS_CBOARDRENDERER_H
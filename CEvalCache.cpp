@@ -0,0 +1,51 @@
+//
+// Created by Petr Smerda on 01.10.2024.
+//
+
+#include "CEvalCache.h"
+#include <algorithm>
+
+
+CEvalCache::CEvalCache(size_t megabytes) {
+  resize(megabytes);
+}
+
+
+void CEvalCache::resize(size_t megabytes) {
+  size_t count = 1;
+  while (count * 2 * sizeof(uint64_t) <= megabytes * 1024 * 1024)
+    count *= 2;
+
+  m_entries.assign(count, 0);
+  m_mask = count - 1;
+  resetCounters();
+}
+
+
+void CEvalCache::clear() {
+  std::fill(m_entries.begin(), m_entries.end(), 0);
+  resetCounters();
+}
+
+
+bool CEvalCache::probe(uint64_t key, int &score) {
+  uint64_t entry = m_entries[key & m_mask];
+
+  if ((entry & KEY_MASK) == (key & KEY_MASK)) {
+    score = static_cast<int16_t>(entry & 0xFFFF);
+    m_hits++;
+    return true;
+  }
+
+  m_misses++;
+  return false;
+}
+
+
+void CEvalCache::store(uint64_t key, int score) {
+  // Scores outside 16 bits are not worth a wider entry, they are just evaluated again
+  if (score != static_cast<int16_t>(score))
+    return;
+
+  m_entries[key & m_mask] = (key & KEY_MASK) | static_cast<uint16_t>(score);
+}
@@ -0,0 +1,45 @@
+//
+// Created by Petr Smerda on 01.10.2024.
+//
+
+#ifndef SFML_CHESS_CEVALCACHE_H
+#define SFML_CHESS_CEVALCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Static evaluations keyed by the position key. An entry is a single word, the upper 48 bits of the key with the
+// score in the low 16, so it is written and read whole and a torn entry cannot happen. Every search thread owns one,
+// like the pawn table.
+class CEvalCache {
+public:
+  explicit CEvalCache(size_t megabytes = 1);
+
+  void resize(size_t megabytes);
+
+  void clear();
+
+  // True and the score if the position was evaluated before
+  bool probe(uint64_t key, int &score);
+
+  void store(uint64_t key, int score);
+
+  uint64_t hits() const { return m_hits; }
+
+  uint64_t misses() const { return m_misses; }
+
+  void resetCounters() { m_hits = m_misses = 0; }
+
+private:
+  static constexpr uint64_t KEY_MASK = ~0xFFFFULL;
+
+  std::vector<uint64_t> m_entries;
+  uint64_t m_mask = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+};
+
+
+#endif //SFML_CHESS_CEVALCACHE_H
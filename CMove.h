@@ -0,0 +1,113 @@
+//
+// Created by Petr Smerda on 05.09.2024.
+//
+
+#ifndef SFML_CHESS_CMOVE_H
+#define SFML_CHESS_CMOVE_H
+
+#include <cstdint>
+#include <string>
+
+
+// Move packed into 16 bits: 6 bits origin square, 6 bits target square and 4 bits of flags
+class CMove {
+public:
+  enum Flags {
+    QUIET = 0,
+    DOUBLE_PUSH = 1,
+    KING_CASTLE = 2,
+    QUEEN_CASTLE = 3,
+    CAPTURE = 4,
+    EN_PASSANT = 5,
+    PROMOTION = 8,  // Lowest two bits select the piece (knight, bishop, rook, queen), CAPTURE may be added
+  };
+
+  // Left uninitialized on purpose, so move lists are not cleared on every construction; CMove() gives the null move
+  CMove() = default;
+
+  CMove(int from, int to, int flags) : m_data(static_cast<uint16_t>(from | to << 6 | flags << 12)) {}
+
+  static CMove fromRaw(uint16_t raw) {
+    CMove move;
+    move.m_data = raw;
+    return move;
+  }
+
+  int from() const { return m_data & 0x3F; }
+
+  int to() const { return (m_data >> 6) & 0x3F; }
+
+  int flags() const { return m_data >> 12; }
+
+  uint64_t fromBB() const { return 1ULL << from(); }
+
+  uint64_t toBB() const { return 1ULL << to(); }
+
+  bool isCapture() const { return flags() & CAPTURE; }
+
+  bool isPromotion() const { return flags() & PROMOTION; }
+
+  bool isEnPassant() const { return flags() == EN_PASSANT; }
+
+  bool isDoublePush() const { return flags() == DOUBLE_PUSH; }
+
+  bool isCastling() const { return flags() == KING_CASTLE || flags() == QUEEN_CASTLE; }
+
+  // Promotion piece in the same notation as the rest of the board ('N', 'B', 'R', 'Q')
+  char promotionPiece() const { return isPromotion() ? "NBRQ"[flags() & 3] : 0; }
+
+  uint16_t raw() const { return m_data; }
+
+  explicit operator bool() const { return m_data != 0; }
+
+  bool operator==(const CMove &other) const { return m_data == other.m_data; }
+
+  bool operator!=(const CMove &other) const { return m_data != other.m_data; }
+
+  // Coordinate notation (e2e4, e7e8q)
+  std::string toString() const {
+    std::string res = {char('a' + from() % 8), char('1' + from() / 8), char('a' + to() % 8), char('1' + to() / 8)};
+
+    if (isPromotion())
+      res += "nbrq"[flags() & 3];
+
+    return res;
+  }
+
+private:
+  uint16_t m_data;
+};
+
+
+// Fixed capacity move list living on the stack, no position has more than 218 legal moves
+class CMoveList {
+public:
+  static constexpr int MAX_MOVES = 256;
+
+  void push_back(CMove move) { m_moves[m_size++] = move; }
+
+  int size() const { return m_size; }
+
+  bool empty() const { return m_size == 0; }
+
+  void clear() { m_size = 0; }
+
+  CMove &operator[](int index) { return m_moves[index]; }
+
+  const CMove &operator[](int index) const { return m_moves[index]; }
+
+  CMove *begin() { return m_moves; }
+
+  CMove *end() { return m_moves + m_size; }
+
+  const CMove *begin() const { return m_moves; }
+
+  const CMove *end() const { return m_moves + m_size; }
+
+private:
+  CMove m_moves[MAX_MOVES];
+  int m_size = 0;
+};
+
+
+#endif //SFML_CHESS_CMOVE_H
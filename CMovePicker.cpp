@@ -0,0 +1,134 @@
+//
+// Created by Petr Smerda on 16.09.2024.
+//
+
+#include "CMovePicker.h"
+
+
+CMovePicker::CMovePicker(const CBoard &board, CMove ttMove, const CMove killers[2], const HistoryTable &history)
+        : m_board(board), m_history(&history), m_ttMove(ttMove), m_killers{killers[0], killers[1]} {
+  // Hash entries may come from another position with the same index, the move is checked before use
+  if (!m_board.isMoveLegal(m_ttMove))
+    m_ttMove = CMove();
+}
+
+
+CMovePicker::CMovePicker(const CBoard &board)
+        : m_board(board), m_history(nullptr), m_ttMove(), m_killers{CMove(), CMove()},
+          m_stage(GENERATE_CAPTURES), m_capturesOnly(true) {}
+
+
+int CMovePicker::pieceValue(char pieceType) {
+  switch (pieceType) {
+    case 'P': return 1;
+    case 'N': return 2;
+    case 'B': return 3;
+    case 'R': return 4;
+    case 'Q': return 5;
+    case 'K': return 6;
+    default:  return 0;
+  }
+}
+
+
+bool CMovePicker::isSpecial(CMove move) const {
+  return move == m_ttMove || move == m_killers[0] || move == m_killers[1];
+}
+
+
+void CMovePicker::scoreCaptures() {
+  for (int i = 0; i < m_moves.size(); ++i) {
+    CMove move = m_moves[i];
+
+    // Most valuable victim first, least valuable attacker among equal victims
+    int victim = move.isEnPassant() ? pieceValue('P') : pieceValue(m_board.pieceAt(move.to()));
+    m_scores[i] = 8 * victim - pieceValue(m_board.pieceAt(move.from()));
+
+    // Queen promotions with the good captures, underpromotions behind everything
+    if (move.isPromotion())
+      m_scores[i] += move.promotionPiece() == 'Q' ? 8 * pieceValue('Q') : -64;
+  }
+}
+
+
+void CMovePicker::scoreQuiets() {
+  for (int i = m_current; i < m_moves.size(); ++i)
+    m_scores[i] = (*m_history)[m_moves[i].from()][m_moves[i].to()];
+}
+
+
+CMove CMovePicker::pickBest() {
+  int best = m_current;
+
+  for (int i = m_current + 1; i < m_moves.size(); ++i)
+    if (m_scores[i] > m_scores[best])
+      best = i;
+
+  std::swap(m_moves[best], m_moves[m_current]);
+  std::swap(m_scores[best], m_scores[m_current]);
+
+  return m_moves[m_current++];
+}
+
+
+CMove CMovePicker::next() {
+  switch (m_stage) {
+    case TT_MOVE:
+      m_stage = GENERATE_CAPTURES;
+      if (m_ttMove)
+        return m_ttMove;
+      [[fallthrough]];
+
+    case GENERATE_CAPTURES:
+      m_board.generateMoves(m_moves, CBoard::GEN_CAPTURES);
+      scoreCaptures();
+      m_stage = CAPTURES;
+      [[fallthrough]];
+
+    case CAPTURES:
+      while (m_current < m_moves.size()) {
+        CMove move = pickBest();
+        if (move != m_ttMove)
+          return move;
+      }
+      if (m_capturesOnly) {
+        m_stage = DONE;
+        return CMove();
+      }
+      m_stage = FIRST_KILLER;
+      [[fallthrough]];
+
+    case FIRST_KILLER:
+      m_stage = SECOND_KILLER;
+      if (m_killers[0] != m_ttMove && m_board.isMoveLegal(m_killers[0]))
+        return m_killers[0];
+      [[fallthrough]];
+
+    case SECOND_KILLER:
+      m_stage = GENERATE_QUIETS;
+      if (m_killers[1] != m_ttMove && m_killers[1] != m_killers[0] && m_board.isMoveLegal(m_killers[1]))
+        return m_killers[1];
+      [[fallthrough]];
+
+    case GENERATE_QUIETS:
+      // Quiet moves go after the captures in the same list
+      m_board.generateMoves(m_moves, CBoard::GEN_QUIETS);
+      scoreQuiets();
+      m_stage = QUIETS;
+      [[fallthrough]];
+
+    case QUIETS:
+      while (m_current < m_moves.size()) {
+        CMove move = pickBest();
+        if (!isSpecial(move))
+          return move;
+      }
+      m_stage = DONE;
+      [[fallthrough]];
+
+    case DONE:
+      return CMove();
+  }
+
+  return CMove();
+}
@@ -0,0 +1,65 @@
+//
+// Created by Petr Smerda on 16.09.2024.
+//
+
+#ifndef SFML_CHESS_CMOVEPICKER_H
+#define SFML_CHESS_CMOVEPICKER_H
+
+#include "CBoard.h"
+#include "CMove.h"
+
+
+// Butterfly table indexed by origin and target square, one per color
+typedef int HistoryTable[64][64];
+
+
+// Hands out the moves of a position one by one, best candidates first. Moves are generated only when the
+// previous stage runs out, so a cutoff on the hash move or a capture saves generating the quiet moves.
+class CMovePicker {
+public:
+  CMovePicker(const CBoard &board, CMove ttMove, const CMove killers[2], const HistoryTable &history);
+
+  // Captures and promotions only, for the quiescence search
+  explicit CMovePicker(const CBoard &board);
+
+  // Null move once all moves were returned
+  CMove next();
+
+  // Value of the piece types for ordering, indexed by 'P', 'N', 'B', 'R', 'Q', 'K'
+  static int pieceValue(char pieceType);
+
+private:
+  enum Stage {
+    TT_MOVE,
+    GENERATE_CAPTURES,
+    CAPTURES,
+    FIRST_KILLER,
+    SECOND_KILLER,
+    GENERATE_QUIETS,
+    QUIETS,
+    DONE,
+  };
+
+  // Selection sort step: swaps the best scored remaining move to the front and returns it
+  CMove pickBest();
+
+  void scoreCaptures();
+
+  void scoreQuiets();
+
+  bool isSpecial(CMove move) const;
+
+  const CBoard &m_board;
+  const HistoryTable *m_history;
+  CMove m_ttMove;
+  CMove m_killers[2];
+
+  Stage m_stage = TT_MOVE;
+  bool m_capturesOnly = false;
+  CMoveList m_moves;
+  int m_scores[CMoveList::MAX_MOVES];
+  int m_current = 0;
+};
+
+
+#endif //SFML_CHESS_CMOVEPICKER_H
@@ -0,0 +1,324 @@
+//
+// Created by Petr Smerda on 28.09.2024.
+//
+
+#include "CNnue.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NNUE_X86
+#include <immintrin.h>
+#endif
+
+
+void *CNnue::m_mapping = nullptr;
+size_t CNnue::m_mappingSize = 0;
+
+const int16_t *CNnue::m_featureBiases = nullptr;
+const int16_t *CNnue::m_featureWeights = nullptr;
+const int32_t *CNnue::m_hidden1Biases = nullptr;
+const int8_t *CNnue::m_hidden1Weights = nullptr;
+const int32_t *CNnue::m_hidden2Biases = nullptr;
+const int8_t *CNnue::m_hidden2Weights = nullptr;
+const int32_t *CNnue::m_outputBias = nullptr;
+const int8_t *CNnue::m_outputWeights = nullptr;
+
+CNnue::DotProduct CNnue::m_dotProduct = nullptr;
+const char *CNnue::m_simdName = "scalar";
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Dot products                        *
+ *                      Dot products                        *
+ *                                                          *
+ ************************************************************
+ */
+
+namespace {
+
+int32_t dotProductScalar(const uint8_t *input, const int8_t *weights, int n) {
+  int32_t sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += input[i] * weights[i];
+
+  return sum;
+}
+
+#if defined(NNUE_X86)
+
+// maddubs multiplies unsigned inputs by signed weights and adds neighbouring pairs into int16, which cannot
+// saturate as the inputs are clipped to 127. madd by ones then widens the pairs into int32.
+
+__attribute__((target("sse4.1")))
+int32_t dotProductSse41(const uint8_t *input, const int8_t *weights, int n) {
+  const __m128i ones = _mm_set1_epi16(1);
+  __m128i sum = _mm_setzero_si128();
+
+  for (int i = 0; i < n; i += 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+    __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(in, w), ones));
+  }
+
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+int32_t dotProductAvx2(const uint8_t *input, const int8_t *weights, int n) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+
+  for (int i = 0; i < n; i += 32) {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+  }
+
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+int32_t dotProductAvx512(const uint8_t *input, const int8_t *weights, int n) {
+  // The narrow layers are only 32 wide
+  if (n % 64)
+    return dotProductAvx2(input, weights, n);
+
+  const __m512i ones = _mm512_set1_epi16(1);
+  __m512i sum = _mm512_setzero_si512();
+
+  for (int i = 0; i < n; i += 64) {
+    __m512i in = _mm512_loadu_si512(input + i);
+    __m512i w = _mm512_loadu_si512(weights + i);
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_maddubs_epi16(in, w), ones));
+  }
+
+  alignas(64) int32_t lanes[16];
+  _mm512_store_si512(lanes, sum);
+
+  int32_t total = 0;
+  for (int32_t lane: lanes)
+    total += lane;
+
+  return total;
+}
+
+#endif
+
+}
+
+
+void CNnue::selectKernel() {
+  m_dotProduct = dotProductScalar;
+  m_simdName = "scalar";
+
+#if defined(NNUE_X86)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512bw")) {
+    m_dotProduct = dotProductAvx512;
+    m_simdName = "AVX-512";
+  } else if (__builtin_cpu_supports("avx2")) {
+    m_dotProduct = dotProductAvx2;
+    m_simdName = "AVX2";
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    m_dotProduct = dotProductSse41;
+    m_simdName = "SSE4.1";
+  }
+#endif
+}
+
+
+void CNnue::useSimd(bool enable) {
+  if (enable)
+    selectKernel();
+  else {
+    m_dotProduct = dotProductScalar;
+    m_simdName = "scalar";
+  }
+}
+
+
+const char *CNnue::simdName() {
+  if (!m_dotProduct)
+    selectKernel();
+
+  return m_simdName;
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Loading                             *
+ *                      Loading                             *
+ *                                                          *
+ ************************************************************
+ */
+
+
+bool CNnue::load(const std::string &path) {
+  constexpr size_t HEADER_SIZE = 16;
+  constexpr std::string_view MAGIC = "CHESSNN1";
+
+  // Offsets of the blocks, each one rounded up to a cache line
+  size_t offset = 0;
+  auto block = [&offset](size_t bytes) {
+    offset = (offset + 63) & ~size_t(63);
+    size_t start = offset;
+    offset += bytes;
+    return start;
+  };
+
+  size_t header = block(HEADER_SIZE);
+  size_t featureBiases = block(HALF_DIMENSIONS * sizeof(int16_t));
+  size_t featureWeights = block(size_t(FEATURES) * HALF_DIMENSIONS * sizeof(int16_t));
+  size_t hidden1Biases = block(HIDDEN * sizeof(int32_t));
+  size_t hidden1Weights = block(HIDDEN * 2 * HALF_DIMENSIONS);
+  size_t hidden2Biases = block(HIDDEN * sizeof(int32_t));
+  size_t hidden2Weights = block(HIDDEN * HIDDEN);
+  size_t outputBias = block(sizeof(int32_t));
+  size_t outputWeights = block(HIDDEN);
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Cannot open network " << path << std::endl;
+    return false;
+  }
+
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < offset) {
+    std::cerr << "Network " << path << " is too small" << std::endl;
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Cannot map network " << path << std::endl;
+    return false;
+  }
+
+  const auto *bytes = static_cast<const uint8_t *>(mapping);
+  uint32_t dimensions[2];
+  std::memcpy(dimensions, bytes + header + MAGIC.size(), sizeof(dimensions));
+
+  if (std::string_view(reinterpret_cast<const char *>(bytes + header), MAGIC.size()) != MAGIC ||
+      dimensions[0] != FEATURES || dimensions[1] != HALF_DIMENSIONS) {
+    std::cerr << "Network " << path << " has a different architecture" << std::endl;
+    munmap(mapping, info.st_size);
+    return false;
+  }
+
+  unload();
+
+  m_mapping = mapping;
+  m_mappingSize = info.st_size;
+
+  m_featureBiases = reinterpret_cast<const int16_t *>(bytes + featureBiases);
+  m_featureWeights = reinterpret_cast<const int16_t *>(bytes + featureWeights);
+  m_hidden1Biases = reinterpret_cast<const int32_t *>(bytes + hidden1Biases);
+  m_hidden1Weights = reinterpret_cast<const int8_t *>(bytes + hidden1Weights);
+  m_hidden2Biases = reinterpret_cast<const int32_t *>(bytes + hidden2Biases);
+  m_hidden2Weights = reinterpret_cast<const int8_t *>(bytes + hidden2Weights);
+  m_outputBias = reinterpret_cast<const int32_t *>(bytes + outputBias);
+  m_outputWeights = reinterpret_cast<const int8_t *>(bytes + outputWeights);
+
+  if (!m_dotProduct)
+    selectKernel();
+
+  return true;
+}
+
+
+void CNnue::unload() {
+  if (m_mapping)
+    munmap(m_mapping, m_mappingSize);
+
+  m_mapping = nullptr;
+  m_mappingSize = 0;
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Inference                           *
+ *                      Inference                           *
+ *                                                          *
+ ************************************************************
+ */
+
+
+int CNnue::featureIndex(int perspective, int kingSquare, char pieceType, bool isWhite, int square) {
+  // Black looks at the board upside down, so both sides see their own pieces as the first kind
+  int flip = perspective == 0 ? 0 : 56;
+  int piece = static_cast<int>(std::string_view("PNBRQ").find(pieceType)) * 2 + (isWhite != (perspective == 0));
+
+  return ((kingSquare ^ flip) * PIECE_KINDS + piece) * 64 + (square ^ flip);
+}
+
+
+void CNnue::initAccumulator(int16_t *accumulator) {
+  std::memcpy(accumulator, m_featureBiases, HALF_DIMENSIONS * sizeof(int16_t));
+}
+
+
+// Plain loops over a whole column, the compiler vectorises them for the target
+void CNnue::addFeature(int16_t *accumulator, int feature) {
+  const int16_t *column = m_featureWeights + static_cast<size_t>(feature) * HALF_DIMENSIONS;
+  for (int i = 0; i < HALF_DIMENSIONS; ++i)
+    accumulator[i] += column[i];
+}
+
+
+void CNnue::removeFeature(int16_t *accumulator, int feature) {
+  const int16_t *column = m_featureWeights + static_cast<size_t>(feature) * HALF_DIMENSIONS;
+  for (int i = 0; i < HALF_DIMENSIONS; ++i)
+    accumulator[i] -= column[i];
+}
+
+
+void CNnue::affine(const uint8_t *input, int inputs, const int32_t *biases, const int8_t *weights, int outputs,
+                   uint8_t *output) {
+  for (int i = 0; i < outputs; ++i) {
+    int32_t sum = biases[i] + m_dotProduct(input, weights + i * inputs, inputs);
+    output[i] = static_cast<uint8_t>(std::clamp(sum >> WEIGHT_SHIFT, 0, CLIP));
+  }
+}
+
+
+int CNnue::propagate(const Accumulator &accumulator, bool whiteToMove) {
+  alignas(64) uint8_t input[2 * HALF_DIMENSIONS];
+  alignas(64) uint8_t hidden1[HIDDEN];
+  alignas(64) uint8_t hidden2[HIDDEN];
+
+  // The side to move always comes first
+  const int16_t *us = accumulator.values[whiteToMove ? 0 : 1];
+  const int16_t *them = accumulator.values[whiteToMove ? 1 : 0];
+
+  for (int i = 0; i < HALF_DIMENSIONS; ++i) {
+    input[i] = static_cast<uint8_t>(std::clamp<int>(us[i], 0, CLIP));
+    input[HALF_DIMENSIONS + i] = static_cast<uint8_t>(std::clamp<int>(them[i], 0, CLIP));
+  }
+
+  affine(input, 2 * HALF_DIMENSIONS, m_hidden1Biases, m_hidden1Weights, HIDDEN, hidden1);
+  affine(hidden1, HIDDEN, m_hidden2Biases, m_hidden2Weights, HIDDEN, hidden2);
+
+  return (m_outputBias[0] + m_dotProduct(hidden2, m_outputWeights, HIDDEN)) / OUTPUT_SCALE;
+}
@@ -0,0 +1,131 @@
+//
+// Created by Petr Smerda on 28.09.2024.
+//
+
+#ifndef SFML_CHESS_CNNUE_H
+#define SFML_CHESS_CNNUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *          Efficiently updatable neural network            *
+ *          Efficiently updatable neural network            *
+ *                                                          *
+ ************************************************************
+ */
+
+// HalfKP network: every side sees the board from its own king, a feature is (own king square, piece, square) for
+// each piece other than the kings. The first layer sums the weight columns of the active features into an int16
+// accumulator per side, which is kept up to date move by move. Two small int8 layers and an output neuron
+// follow, they run on SSE4.1, AVX2 or AVX-512 when the CPU has it.
+//
+// The weights are memory mapped from a file laid out as
+//   header    "CHESSNN1", uint32 features, uint32 half dimensions
+//   int16     feature biases [256], feature weights [40960][256]
+//   int32/int8 hidden 1 biases [32], weights [32][512]
+//   int32/int8 hidden 2 biases [32], weights [32][32]
+//   int32/int8 output bias [1], weights [32]
+// every block starting at a multiple of 64 bytes, all little-endian.
+class CNnue {
+public:
+  static constexpr int PIECE_KINDS = 10;          // Pawn to queen of both colours
+  static constexpr int FEATURES = 64 * PIECE_KINDS * 64;
+  static constexpr int HALF_DIMENSIONS = 256;
+  static constexpr int HIDDEN = 32;
+
+  // First layer output of both perspectives, white is 0
+  struct alignas(64) Accumulator {
+    int16_t values[2][HALF_DIMENSIONS];
+  };
+
+  // Maps the network, keeps the previous one if the file does not fit the layout
+  static bool load(const std::string &path);
+
+  static void unload();
+
+  static bool loaded() { return m_mapping != nullptr; }
+
+  // Scalar kernels only, for comparing against the vectorised ones
+  static void useSimd(bool enable);
+
+  static const char *simdName();
+
+  static int featureIndex(int perspective, int kingSquare, char pieceType, bool isWhite, int square);
+
+  static void initAccumulator(int16_t *accumulator);
+
+  static void addFeature(int16_t *accumulator, int feature);
+
+  static void removeFeature(int16_t *accumulator, int feature);
+
+  // Score in centipawns for the side to move
+  static int propagate(const Accumulator &accumulator, bool whiteToMove);
+
+private:
+  // Sum of input * weight over n bytes, n being a multiple of 32
+  typedef int32_t (*DotProduct)(const uint8_t *input, const int8_t *weights, int n);
+
+  static constexpr int WEIGHT_SHIFT = 6;  // Hidden layer weights are scaled by 64
+  static constexpr int OUTPUT_SCALE = 16;
+  static constexpr int CLIP = 127;
+
+  static void selectKernel();
+
+  static void affine(const uint8_t *input, int inputs, const int32_t *biases, const int8_t *weights,
+                     int outputs, uint8_t *output);
+
+  static void *m_mapping;
+  static size_t m_mappingSize;
+
+  static const int16_t *m_featureBiases;
+  static const int16_t *m_featureWeights;
+  static const int32_t *m_hidden1Biases;
+  static const int8_t *m_hidden1Weights;
+  static const int32_t *m_hidden2Biases;
+  static const int8_t *m_hidden2Weights;
+  static const int32_t *m_outputBias;
+  static const int8_t *m_outputWeights;
+
+  static DotProduct m_dotProduct;
+  static const char *m_simdName;
+};
+
+
+// Accumulators along the line a search is on, indexed by ply like the states of the board. The search thread owns
+// them rather than the board, so copying a board stays cheap and nothing is allocated without a network. An entry is
+// valid only for the position whose key it holds.
+class CAccumulatorStack {
+public:
+  struct Entry {
+    CNnue::Accumulator accumulator;
+    uint64_t key;
+    bool computed;
+  };
+
+  // Grows in large steps, so the search allocates nothing once it is deep enough
+  void reserve(size_t plies) {
+    if (plies > m_entries.size())
+      m_entries.resize(std::max<size_t>(128, plies * 2));
+  }
+
+  Entry &operator[](size_t ply) { return m_entries[ply]; }
+
+  // Needed whenever another network is loaded, the keys would still match
+  void clear() {
+    for (Entry &entry: m_entries)
+      entry.computed = false;
+  }
+
+private:
+  std::vector<Entry> m_entries;
+};
+
+
+#endif //SFML_CHESS_CNNUE_H
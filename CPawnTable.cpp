@@ -0,0 +1,44 @@
+//
+// Created by Petr Smerda on 23.09.2024.
+//
+
+#include "CPawnTable.h"
+
+
+CPawnTable::CPawnTable(size_t megabytes) {
+  resize(megabytes);
+}
+
+
+void CPawnTable::resize(size_t megabytes) {
+  // Power of two, so the slot is just the low bits of the key
+  size_t count = 1;
+  while (count * 2 * sizeof(PawnEntry) <= megabytes * 1024 * 1024)
+    count *= 2;
+
+  m_entries.assign(count, PawnEntry());
+  m_mask = count - 1;
+  clear();
+}
+
+
+void CPawnTable::clear() {
+  // Key 0 belongs to positions without pawns, so empty slots need a key that does not occur
+  for (PawnEntry &entry: m_entries)
+    entry.key = ~0ULL;
+
+  resetCounters();
+}
+
+
+PawnEntry &CPawnTable::probe(uint64_t key, bool &found) {
+  PawnEntry &entry = m_entries[key & m_mask];
+  found = entry.key == key;
+
+  if (found)
+    m_hits++;
+  else
+    m_misses++;
+
+  return entry;
+}
@@ -0,0 +1,54 @@
+//
+// Created by Petr Smerda on 23.09.2024.
+//
+
+#ifndef SFML_CHESS_CPAWNTABLE_H
+#define SFML_CHESS_CPAWNTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CScore.h"
+
+
+// Everything the evaluation knows about the pawns alone. Files are 8-bit masks, bit 0 being the a-file.
+struct PawnEntry {
+  uint64_t key;
+  Score score;             // Pawn structure from white's point of view
+  uint64_t wPassed;
+  uint64_t bPassed;
+  uint64_t wAttackSpans;   // Squares the pawns of the side could attack, now or after advancing
+  uint64_t bAttackSpans;
+  uint8_t openFiles;       // No pawns at all
+  uint8_t wHalfOpenFiles;  // No white pawns, but black ones
+  uint8_t bHalfOpenFiles;
+};
+
+
+// Cache of pawn structure evaluations keyed by the pawn key. Not shared, every search thread owns one.
+class CPawnTable {
+public:
+  explicit CPawnTable(size_t megabytes = 1);
+
+  void resize(size_t megabytes);
+
+  void clear();
+
+  // Slot for the key, found tells whether it already holds the entry of these pawns
+  PawnEntry &probe(uint64_t key, bool &found);
+
+  uint64_t hits() const { return m_hits; }
+
+  uint64_t misses() const { return m_misses; }
+
+  void resetCounters() { m_hits = m_misses = 0; }
+
+private:
+  std::vector<PawnEntry> m_entries;
+  uint64_t m_mask = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+};
+
+
+#endif //SFML_CHESS_CPAWNTABLE_H
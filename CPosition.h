@@ -0,0 +1,45 @@
+//
+// Created by Petr Smerda on 07.10.2024.
+//
+
+#ifndef SFML_CHESS_CPOSITION_H
+#define SFML_CHESS_CPOSITION_H
+
+#include <cstdint>
+#include <type_traits>
+#include "CScore.h"
+
+typedef uint64_t Bitboard;
+
+
+// Everything that describes a position and nothing else, so it can be copied with a plain memcpy, stored or handed
+// to another thread. CBoard adds the move history and the rules on top of it.
+struct Position {
+  Bitboard wPawns, wKnights, wBishops, wRooks, wQueens, wKing;
+  Bitboard bPawns, bKnights, bBishops, bRooks, bQueens, bKing;
+
+  // Target squares of the king for the castlings still allowed
+  Bitboard wCastling;
+  Bitboard bCastling;
+
+  // Square a pawn skipped with its double push in the last move
+  Bitboard enPassant;
+
+  int onTurn;  // 1 for white, -1 for black
+
+  // Plies since the last capture or pawn move
+  int halfmoveClock;
+
+  // Zobrist keys of the whole position and of the pawns only
+  uint64_t key;
+  uint64_t pawnKey;
+
+  // Material and piece-square scores from white's point of view
+  Score material;
+  Score psqt;
+};
+
+static_assert(std::is_trivially_copyable_v<Position>, "Position must stay copyable with memcpy");
+
+
+#endif //SFML_CHESS_CPOSITION_H
@@ -0,0 +1,29 @@
+//
+// Created by Petr Smerda on 25.09.2024.
+//
+
+#ifndef SFML_CHESS_CSCORE_H
+#define SFML_CHESS_CSCORE_H
+
+#include <cstdint>
+
+
+// Middlegame and endgame value of an evaluation term packed into one integer, the endgame value in the upper
+// 16 bits. Adding, subtracting or multiplying by an integer updates both halves at once.
+typedef int32_t Score;
+
+constexpr Score makeScore(int mg, int eg) {
+  return static_cast<Score>(static_cast<uint32_t>(eg) << 16) + mg;
+}
+
+constexpr int mgValue(Score score) {
+  return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint32_t>(score)));
+}
+
+// The rounding makes up for the borrow a negative middlegame value took from the upper half
+constexpr int egValue(Score score) {
+  return static_cast<int16_t>(static_cast<uint16_t>((static_cast<uint32_t>(score) + 0x8000) >> 16));
+}
+
+
+#endif //SFML_CHESS_CSCORE_H
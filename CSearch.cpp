@@ -0,0 +1,536 @@
+//
+// Created by Petr Smerda on 14.09.2024.
+//
+
+#include "CSearch.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+CSearch::CSearch(const CBoard &board, CTranspositionTable &tt, std::atomic<bool> &stop, std::atomic<bool> &ponder,
+                 std::atomic<uint64_t> &poolNodes, int threadId)
+        : m_board(board), m_tt(tt), m_stop(stop), m_ponder(ponder), m_poolNodes(poolNodes), m_threadId(threadId),
+          m_killers(), m_history() {}
+
+
+void CSearch::setPosition(const CBoard &board) {
+  m_board = board;
+}
+
+
+bool CSearch::skipDepth(int depth) const {
+  // Helper i searches only the depths where (depth + phase) / size is even
+  static constexpr int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+  static constexpr int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+  if (m_threadId == 0)
+    return false;
+
+  int i = (m_threadId - 1) % 20;
+  return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2 != 0;
+}
+
+
+bool CSearch::isSearchMove(CMove move) const {
+  return m_limits.searchMoves.empty() ||
+         std::find(m_limits.searchMoves.begin(), m_limits.searchMoves.end(), move) != m_limits.searchMoves.end();
+}
+
+
+SearchResult CSearch::think(const SearchLimits &limits) {
+  m_limits = limits;
+  m_start = std::chrono::steady_clock::now();
+  m_nodes.store(0, std::memory_order_relaxed);
+  m_tbHits = 0;
+  m_aborted = false;
+  m_pondering = limits.ponder && m_threadId == 0;
+  m_rootBest = CMove();
+  m_completedDepth = 0;
+  m_pawnTable.resetCounters();
+  m_evalCache.resetCounters();
+
+  // The network may have changed since the last search
+  m_accumulators.clear();
+
+  // Killers belong to the previous position, history is only made less important
+  for (auto &killers: m_killers)
+    killers[0] = killers[1] = CMove();
+
+  for (auto &side: m_history)
+    for (auto &from: side)
+      for (int &value: from)
+        value /= 2;
+
+  SearchResult result;
+
+  CMoveList rootMoves, allMoves;
+  m_board.generateMoves(allMoves);
+
+  // Restricted to the given moves, unless none of them is legal here
+  for (CMove move: allMoves)
+    if (isSearchMove(move))
+      rootMoves.push_back(move);
+
+  if (rootMoves.empty() && !allMoves.empty()) {
+    m_limits.searchMoves.clear();
+    rootMoves = allMoves;
+  }
+
+  if (rootMoves.empty()) {
+    result.score = m_board.inCheck() ? -MATE_VALUE : 0;
+    return result;
+  }
+
+  // In a tablebase ending the tables pick the move, with no search at all. They choose among all moves.
+  int wdl, dtz;
+  if (m_limits.searchMoves.empty() && CTablebase::probeRoot(m_board, result.bestMove, wdl, dtz)) {
+    result.score = wdl == CTablebase::WDL_WIN ? TB_WIN : wdl == CTablebase::WDL_LOSS ? -TB_WIN : 0;
+    result.depth = 1;
+    result.pv = {result.bestMove};
+    result.tbHits = 1;
+    result.dtz = dtz;
+    result.timeMs = elapsedMs();
+
+    // Reported like a finished iteration, so the score is known before the move
+    if (m_onIteration)
+      m_onIteration(result);
+
+    return result;
+  }
+
+  // Something to play even if the first iteration does not finish
+  result.bestMove = rootMoves[0];
+
+  int maxDepth = limits.depth > 0 && limits.depth < MAX_PLY ? limits.depth : MAX_PLY;
+
+  for (int depth = 1; depth <= maxDepth; ++depth) {
+    if (skipDepth(depth) && depth < maxDepth)
+      continue;
+
+    int score = aspiration(depth, result.score);
+
+    // Results of an unfinished iteration are not reliable
+    if (m_aborted)
+      break;
+
+    result.bestMove = m_rootBest;
+    result.score = score;
+    result.depth = depth;
+    m_completedDepth = depth;
+    result.pv.assign(m_pv[0], m_pv[0] + m_pvLength[0]);
+
+    seedPv();
+
+    if (m_onIteration) {
+      result.nodes = nodes();
+      result.timeMs = elapsedMs();
+      m_onIteration(result);
+    }
+
+    // The next iteration takes longer than all previous ones together, it would not finish in time anyway
+    if (limits.timeMs && !pondering() && elapsedMs() * 2 > limits.timeMs)
+      break;
+  }
+
+  result.nodes = nodes();
+  result.timeMs = elapsedMs();
+  result.pawnHits = m_pawnTable.hits();
+  result.pawnMisses = m_pawnTable.misses();
+  result.evalHits = m_evalCache.hits();
+  result.evalMisses = m_evalCache.misses();
+  result.tbHits = m_tbHits;
+  return result;
+}
+
+
+int CSearch::aspiration(int depth, int previousScore) {
+  int delta = ASPIRATION_WINDOW;
+  int alpha = -INFINITE;
+  int beta = INFINITE;
+
+  if (depth >= ASPIRATION_DEPTH && !isDecisiveScore(previousScore)) {
+    alpha = std::max(previousScore - delta, -INFINITE);
+    beta = std::min(previousScore + delta, INFINITE);
+  }
+
+  while (true) {
+    int score = negamax(depth, alpha, beta, 0);
+
+    if (m_aborted)
+      return 0;
+
+    // Fail low pulls beta towards the window too, the true score is below the old guess
+    if (score <= alpha) {
+      beta = (alpha + beta) / 2;
+      alpha = std::max(score - delta, -INFINITE);
+    } else if (score >= beta)
+      beta = std::min(score + delta, INFINITE);
+    else
+      return score;
+
+    delta += delta / 2;
+  }
+}
+
+
+void CSearch::updatePv(int ply, CMove move) {
+  m_pv[ply][ply] = move;
+
+  for (int i = ply + 1; i < m_pvLength[ply + 1]; ++i)
+    m_pv[ply][i] = m_pv[ply + 1][i];
+
+  m_pvLength[ply] = m_pvLength[ply + 1];
+}
+
+
+void CSearch::seedPv() {
+  int played = 0;
+
+  for (int i = 0; i < m_pvLength[0]; ++i) {
+    CTranspositionTable::Data entry = {};
+
+    if (!m_tt.probe(m_board.key(), entry))
+      m_tt.store(m_board.key(), m_pv[0][i], 0, 0, CTranspositionTable::BOUND_NONE);
+
+    if (!m_board.isMoveLegal(m_pv[0][i]))
+      break;
+
+    m_board.makeMove(m_pv[0][i]);
+    played++;
+  }
+
+  while (played--)
+    m_board.unmakeMove();
+}
+
+
+bool CSearch::checkLimits() {
+  uint64_t nodes = m_nodes.load(std::memory_order_relaxed);
+
+  // The limit holds for all threads together, this thread's nodes not yet added to the pool count are added here
+  uint64_t poolNodes = m_poolNodes.load(std::memory_order_relaxed) + (nodes & (NODE_BATCH - 1));
+
+  if (m_stop.load(std::memory_order_relaxed) || (m_limits.nodes && poolNodes >= m_limits.nodes) ||
+      (m_limits.timeMs && (nodes & 255) == 0 && !pondering() && elapsedMs() >= m_limits.timeMs))
+    m_aborted = true;
+
+  return m_aborted;
+}
+
+
+bool CSearch::pondering() {
+  // Time spent pondering is free, the clock starts with ponderhit
+  if (m_pondering && !m_ponder.load(std::memory_order_relaxed)) {
+    m_pondering = false;
+    m_start = std::chrono::steady_clock::now();
+  }
+
+  return m_pondering;
+}
+
+
+int64_t CSearch::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+
+int CSearch::scoreToTT(int score, int ply) {
+  return score >= TB_WIN - MAX_PLY ? score + ply : score <= -TB_WIN + MAX_PLY ? score - ply : score;
+}
+
+int CSearch::scoreFromTT(int score, int ply) {
+  return score >= TB_WIN - MAX_PLY ? score - ply : score <= -TB_WIN + MAX_PLY ? score + ply : score;
+}
+
+
+int CSearch::reduction(int depth, int moveCount) {
+  static const auto table = [] {
+    std::array<std::array<int, 64>, MAX_PLY> reductions = {};
+
+    for (int d = 1; d < MAX_PLY; ++d)
+      for (int m = 1; m < 64; ++m)
+        reductions[d][m] = static_cast<int>(0.75 + std::log(d) * std::log(m) / 2.25);
+
+    return reductions;
+  }();
+
+  return table[std::min(depth, MAX_PLY - 1)][std::min(moveCount, 63)];
+}
+
+
+int CSearch::negamax(int depth, int alpha, int beta, int ply, bool nullAllowed) {
+  countNode();
+  m_pvLength[ply] = ply;
+
+  // The first iteration always finishes, so there is a move to return
+  if (m_aborted || (m_completedDepth && checkLimits()))
+    return 0;
+
+  // Below the root a repeated position is a draw, otherwise a won position could be shuffled into one
+  if (ply > 0 && m_board.isDraw())
+    return 0;
+
+  if (depth <= 0)
+    return quiescence(alpha, beta, ply);
+
+  if (ply >= MAX_PLY)
+    return evaluate();
+
+  CTranspositionTable::Data entry = {};
+  bool hit = m_tt.probe(m_board.key(), entry);
+
+  // No cutoffs in PV nodes, they would cut the line short
+  if (hit && ply > 0 && entry.depth >= depth && beta - alpha == 1) {
+    int score = scoreFromTT(entry.score, ply);
+
+    if (entry.bound == CTranspositionTable::BOUND_EXACT ||
+        (entry.bound == CTranspositionTable::BOUND_LOWER && score >= beta) ||
+        (entry.bound == CTranspositionTable::BOUND_UPPER && score <= alpha))
+      return score;
+  }
+
+  // Inside the tree a tablebase ending needs no search, only the result
+  int wdl;
+  if (ply > 0 && m_board.pieceCount() <= CTablebase::maxPieces() && CTablebase::probeWdl(m_board, wdl)) {
+    m_tbHits++;
+
+    int score = wdl == CTablebase::WDL_WIN ? TB_WIN - ply : wdl == CTablebase::WDL_LOSS ? -TB_WIN + ply : 0;
+    m_tt.store(m_board.key(), CMove(), scoreToTT(score, ply), MAX_PLY, CTranspositionTable::BOUND_EXACT);
+    return score;
+  }
+
+  // Pruning is only done in null window nodes, nodes with a real window decide the principal variation
+  bool pvNode = beta - alpha > 1;
+  bool inCheck = m_board.inCheck();
+  int staticEval = inCheck ? -INFINITE : evaluate();
+
+  // Reverse futility pruning: so far above beta that the last few plies will not bring it down
+  if (m_options.futility && !pvNode && !inCheck && depth <= FUTILITY_DEPTH && !isDecisiveScore(beta) &&
+      staticEval - FUTILITY_MARGIN * depth >= beta)
+    return staticEval;
+
+  // Null move pruning: if passing still fails high, a real move would as well. Not with only pawns left, where
+  // passing may be the best move (zugzwang), and never twice in a row.
+  if (m_options.nullMove && !pvNode && !inCheck && nullAllowed && depth >= 3 && staticEval >= beta &&
+      m_board.hasNonPawnMaterial()) {
+    int r = 3 + depth / 6;
+
+    m_board.makeNullMove();
+    int score = -negamax(depth - 1 - r, -beta, -beta + 1, ply + 1, false);
+    m_board.unmakeNullMove();
+
+    if (m_aborted)
+      return 0;
+
+    if (score >= beta) {
+      // Unproven mates are not returned
+      if (isDecisiveScore(score))
+        score = beta;
+
+      if (depth < NULL_VERIFY_DEPTH || negamax(depth - r, beta - 1, beta, ply, false) >= beta)
+        return score;
+    }
+  }
+
+  CMovePicker picker(m_board, hit ? entry.move : CMove(), m_killers[ply], m_history[m_board.whiteToMove()]);
+  CMoveList quietsTried;
+
+  int originalAlpha = alpha;
+  int bestScore = -INFINITE;
+  CMove bestMove = CMove();
+  int moveCount = 0;
+
+  while (CMove move = picker.next()) {
+    if (ply == 0 && !isSearchMove(move))
+      continue;
+
+    moveCount++;
+
+    bool isQuiet = !move.isCapture() && !move.isPromotion();
+    bool isKiller = move == m_killers[ply][0] || move == m_killers[ply][1];
+
+    m_board.makeMove(move);
+    bool givesCheck = m_board.inCheck();
+
+    // Futility pruning: a quiet move will not lift a hopeless static evaluation to alpha near the leaves
+    if (m_options.futility && !pvNode && !inCheck && !givesCheck && isQuiet && moveCount > 1 &&
+        depth <= FUTILITY_DEPTH && !isDecisiveScore(alpha) && staticEval + FUTILITY_MARGIN * depth <= alpha) {
+      m_board.unmakeMove();
+      continue;
+    }
+
+    int score;
+    int newDepth = depth - 1;
+    int r = 0;
+
+    // Late move reductions: quiet moves ordered late rarely turn out best, they are searched shallower first
+    if (m_options.lateMoveReductions && depth >= 3 && moveCount > 3 && isQuiet && !isKiller && !inCheck &&
+        !givesCheck)
+      r = std::clamp(reduction(depth, moveCount) - pvNode, 0, newDepth - 1);
+
+    // Principal variation search: the first move gets the full window, the others only have to prove they are
+    // not better with a null window, and are searched again with the full window if they are
+    if (moveCount == 1)
+      score = -negamax(newDepth, -beta, -alpha, ply + 1);
+    else {
+      score = -negamax(newDepth - r, -alpha - 1, -alpha, ply + 1);
+
+      if (r > 0 && score > alpha && !m_aborted)
+        score = -negamax(newDepth, -alpha - 1, -alpha, ply + 1);
+
+      if (pvNode && score > alpha && score < beta && !m_aborted)
+        score = -negamax(newDepth, -beta, -alpha, ply + 1);
+    }
+
+    m_board.unmakeMove();
+
+    if (m_aborted)
+      return 0;
+
+    if (score > bestScore) {
+      bestScore = score;
+      bestMove = move;
+    }
+
+    if (score > alpha) {
+      alpha = score;
+
+      if (pvNode)
+        updatePv(ply, move);
+
+      // Moves failing low at the root are only upper bounds, the previous best stays
+      if (ply == 0)
+        m_rootBest = move;
+    }
+
+    if (alpha >= beta) {
+      if (isQuiet)
+        updateQuietStats(move, quietsTried, depth, ply);
+      break;
+    }
+
+    if (isQuiet)
+      quietsTried.push_back(move);
+  }
+
+  // Checkmate or stalemate
+  if (!moveCount)
+    return inCheck ? -MATE_VALUE + ply : 0;
+
+  CTranspositionTable::Bound bound = bestScore >= beta ? CTranspositionTable::BOUND_LOWER :
+                                     bestScore > originalAlpha ? CTranspositionTable::BOUND_EXACT
+                                                               : CTranspositionTable::BOUND_UPPER;
+
+  m_tt.store(m_board.key(), bestMove, scoreToTT(bestScore, ply), depth, bound);
+
+  return bestScore;
+}
+
+
+int CSearch::evaluate() {
+  // The same positions come back in every iteration and through transpositions
+  int score;
+  if (m_evalCache.probe(m_board.key(), score))
+    return score;
+
+  // Evaluation is from white's point of view
+  score = m_board.evaluate(m_pawnTable, m_accumulators);
+  if (!m_board.whiteToMove())
+    score = -score;
+
+  m_evalCache.store(m_board.key(), score);
+  return score;
+}
+
+
+int CSearch::quiescence(int alpha, int beta, int ply) {
+  countNode();
+  m_pvLength[ply] = ply;
+
+  if (m_aborted || (m_completedDepth && checkLimits()))
+    return 0;
+
+  if (ply >= MAX_PLY)
+    return evaluate();
+
+  // In check there is no standing pat, every evasion is searched so mates are seen
+  bool inCheck = m_board.inCheck();
+  int standPat = -INFINITE;
+  int bestScore = -INFINITE;
+
+  if (!inCheck) {
+    standPat = bestScore = evaluate();
+
+    if (standPat >= beta)
+      return standPat;
+
+    if (standPat > alpha)
+      alpha = standPat;
+  }
+
+  CMovePicker picker = inCheck ? CMovePicker(m_board, CMove(), m_killers[ply], m_history[m_board.whiteToMove()])
+                               : CMovePicker(m_board);
+  int moveCount = 0;
+
+  while (CMove move = picker.next()) {
+    if (ply == 0 && !isSearchMove(move))
+      continue;
+
+    moveCount++;
+
+    if (!inCheck) {
+      // Delta pruning: even winning the piece outright would not bring the score up to alpha
+      int captured = move.isEnPassant() ? CBoard::pieceValue('P') : CBoard::pieceValue(m_board.pieceAt(move.to()));
+      if (!move.isPromotion() && standPat + captured + DELTA_MARGIN <= alpha)
+        continue;
+
+      // Captures losing material in the exchange
+      if (m_board.see(move) < 0)
+        continue;
+    }
+
+    m_board.makeMove(move);
+    int score = -quiescence(-beta, -alpha, ply + 1);
+    m_board.unmakeMove();
+
+    if (m_aborted)
+      return 0;
+
+    if (score > bestScore)
+      bestScore = score;
+
+    if (score > alpha)
+      alpha = score;
+
+    if (alpha >= beta)
+      break;
+  }
+
+  if (inCheck && !moveCount)
+    return -MATE_VALUE + ply;
+
+  return bestScore;
+}
+
+
+void CSearch::updateQuietStats(CMove best, const CMoveList &quietsTried, int depth, int ply) {
+  if (best != m_killers[ply][0]) {
+    m_killers[ply][1] = m_killers[ply][0];
+    m_killers[ply][0] = best;
+  }
+
+  HistoryTable &history = m_history[m_board.whiteToMove()];
+  int bonus = depth * depth < HISTORY_MAX / 16 ? depth * depth : HISTORY_MAX / 16;
+
+  // Every update moves the value part of the way towards the limit, so it stays within +-HISTORY_MAX
+  auto update = [&](CMove move, int delta) {
+    int &value = history[move.from()][move.to()];
+    value += delta - value * (delta < 0 ? -delta : delta) / HISTORY_MAX;
+  };
+
+  update(best, bonus);
+
+  for (CMove move: quietsTried)
+    update(move, -bonus);
+}
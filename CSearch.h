@@ -0,0 +1,191 @@
+//
+// Created by Petr Smerda on 14.09.2024.
+//
+
+#ifndef SFML_CHESS_CSEARCH_H
+#define SFML_CHESS_CSEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "CBoard.h"
+#include "CEvalCache.h"
+#include "CMovePicker.h"
+#include "CPawnTable.h"
+#include "CTablebase.h"
+#include "CTranspositionTable.h"
+
+
+// Any limit left at zero is not applied
+struct SearchLimits {
+  int depth = 0;
+  uint64_t nodes = 0;
+  int64_t timeMs = 0;
+  bool ponder = false;  // Searching on the opponent's time, the time limit applies only from ponderhit on
+  std::vector<CMove> searchMoves;  // Root moves to choose from, all of them when empty
+};
+
+// Selective search features, switchable for measuring
+struct SearchOptions {
+  bool nullMove = true;
+  bool lateMoveReductions = true;
+  bool futility = true;
+};
+
+struct SearchResult {
+  CMove bestMove = CMove();
+  int score = 0;
+  int depth = 0;       // Last completed iteration
+  uint64_t nodes = 0;
+  int64_t timeMs = 0;
+  uint64_t pawnHits = 0;
+  uint64_t pawnMisses = 0;
+  uint64_t evalHits = 0;
+  uint64_t evalMisses = 0;
+  uint64_t tbHits = 0;
+  int dtz = -1;           // Plies to the next capture or mate when the tables decided the root, -1 otherwise
+  std::vector<CMove> pv;  // Expected line starting with bestMove
+};
+
+
+// Alpha-beta search on its own copy of the board, driven by iterative deepening. Every search thread owns one,
+// the threads share only the transposition table and the stop flag.
+class alignas(64) CSearch {
+public:
+  static constexpr int MAX_PLY = 64;
+  static constexpr int INFINITE = 32000;
+  static constexpr int MATE_VALUE = 30000;  // Mate at the root, mate in n plies scores MATE_VALUE - n
+  static constexpr int TB_WIN = MATE_VALUE - 2 * MAX_PLY;  // Tablebase win n plies from the root, below any mate
+
+  // Thread 0 is the main thread, the others are helpers that search the same position at staggered depths. The ponder
+  // flag is cleared on ponderhit, the pool nodes are counted by all threads and checked against the node limit.
+  CSearch(const CBoard &board, CTranspositionTable &tt, std::atomic<bool> &stop, std::atomic<bool> &ponder,
+          std::atomic<uint64_t> &poolNodes, int threadId = 0);
+
+  void setPosition(const CBoard &board);
+
+  void setOptions(const SearchOptions &options) { m_options = options; }
+
+  CPawnTable &pawnTable() { return m_pawnTable; }
+
+  CEvalCache &evalCache() { return m_evalCache; }
+
+  // Called with the result of every completed iteration, from the searching thread
+  void setInfoCallback(std::function<void(const SearchResult &)> callback) { m_onIteration = std::move(callback); }
+
+  // Nodes of the running search, may be read from other threads
+  uint64_t nodes() const { return m_nodes.load(std::memory_order_relaxed); }
+
+  // Runs until a limit is hit or the stop flag is raised, then returns the result of the last completed iteration
+  SearchResult think(const SearchLimits &limits);
+
+  static bool isMateScore(int score) { return score >= MATE_VALUE - MAX_PLY || score <= -MATE_VALUE + MAX_PLY; }
+
+  // Mate or tablebase result, nothing the evaluation could produce
+  static bool isDecisiveScore(int score) { return score >= TB_WIN - MAX_PLY || score <= -TB_WIN + MAX_PLY; }
+
+private:
+  static constexpr int HISTORY_MAX = 16384;
+
+  // Nodes added to the pool count at once, a locked add for every node would have the threads fight over its line
+  static constexpr uint64_t NODE_BATCH = 1024;
+
+  // Margin on top of the captured piece for the positional gain of a capture
+  static constexpr int DELTA_MARGIN = 200;
+
+  // Futility pruning works up to this depth, allowing the evaluation to be off by the margin per ply
+  static constexpr int FUTILITY_DEPTH = 3;
+  static constexpr int FUTILITY_MARGIN = 120;
+
+  // Half width of the first aspiration window, and the depth from which the windows are used
+  static constexpr int ASPIRATION_WINDOW = 25;
+  static constexpr int ASPIRATION_DEPTH = 5;
+
+  // Null move results are checked by a normal reduced search from this depth on, in case of zugzwang
+  static constexpr int NULL_VERIFY_DEPTH = 10;
+
+  // Searches the root with a narrow window around the previous score, widening it until the score falls inside
+  int aspiration(int depth, int previousScore);
+
+  int negamax(int depth, int alpha, int beta, int ply, bool nullAllowed = true);
+
+  // Puts the move in front of the child's line
+  void updatePv(int ply, CMove move);
+
+  // Stores the line in the table, so the next iteration searches it first even if the entries were replaced
+  void seedPv();
+
+  // Late move reduction for the given depth and move number, grows with the logarithm of both
+  static int reduction(int depth, int moveCount);
+
+  // Searches captures until the position is quiet, so the evaluation is never taken in the middle of an exchange
+  int quiescence(int alpha, int beta, int ply);
+
+  // From the side to move's point of view
+  int evaluate();
+
+  bool checkLimits();
+
+  // Whether the search is still pondering, starts the clock once ponderhit came
+  bool pondering();
+
+  // Only the owning thread writes the counter, so a plain load and store do instead of a locked increment
+  void countNode() {
+    uint64_t nodes = m_nodes.load(std::memory_order_relaxed) + 1;
+    m_nodes.store(nodes, std::memory_order_relaxed);
+
+    if ((nodes & (NODE_BATCH - 1)) == 0)
+      m_poolNodes.fetch_add(NODE_BATCH, std::memory_order_relaxed);
+  }
+
+  int64_t elapsedMs() const;
+
+  // Mate and tablebase scores are stored relative to the node, not to the root
+  static int scoreToTT(int score, int ply);
+
+  static int scoreFromTT(int score, int ply);
+
+  // Rewards the quiet move that caused a cutoff and punishes the quiet moves searched before it
+  void updateQuietStats(CMove best, const CMoveList &quietsTried, int depth, int ply);
+
+  // Helper threads skip some iterations, so they are not all searching the same depth
+  bool skipDepth(int depth) const;
+
+  // Whether the move may be played at the root, see SearchLimits::searchMoves
+  bool isSearchMove(CMove move) const;
+
+  CBoard m_board;
+  CTranspositionTable &m_tt;
+  std::atomic<bool> &m_stop;
+  std::atomic<bool> &m_ponder;
+  std::atomic<uint64_t> &m_poolNodes;
+  int m_threadId;
+
+  SearchLimits m_limits;
+  SearchOptions m_options;
+  std::chrono::steady_clock::time_point m_start;
+  std::atomic<uint64_t> m_nodes{0};
+  uint64_t m_tbHits = 0;
+  bool m_aborted = false;
+  bool m_pondering = false;
+  std::function<void(const SearchResult &)> m_onIteration;
+  CMove m_rootBest = CMove();
+  int m_completedDepth = 0;  // No limit applies before the first iteration is done
+
+  // Triangular PV table: row ply holds the best line from that ply, filled from the row below
+  CMove m_pv[MAX_PLY + 1][MAX_PLY + 1];
+  int m_pvLength[MAX_PLY + 1];
+
+  // Move ordering statistics, private to the thread running the search
+  CMove m_killers[MAX_PLY][2];
+  HistoryTable m_history[2];
+
+  CPawnTable m_pawnTable;
+  CEvalCache m_evalCache;
+  CAccumulatorStack m_accumulators;  // Empty until a network is used
+};
+
+
+#endif //SFML_CHESS_CSEARCH_H
@@ -0,0 +1,170 @@
+//
+// Created by Petr Smerda on 19.09.2024.
+//
+
+#include "CSearchPool.h"
+#include <algorithm>
+#include <thread>
+
+
+CSearchPool::CSearchPool(CTranspositionTable &tt, int threads) : m_tt(tt) {
+  setThreads(threads);
+}
+
+
+void CSearchPool::setThreads(int threads) {
+  if (threads <= 0)
+    threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+  m_helpers.reset();
+  m_searches.clear();
+
+  // Each search is allocated separately and aligned to a cache line, threads never write to a shared line
+  CBoard board;
+  for (int i = 0; i < threads; ++i)
+    m_searches.push_back(std::make_unique<CSearch>(board, m_tt, m_stop, m_ponder, m_nodes, i));
+
+  setOptions(m_options);
+  setInfoCallback(m_infoCallback);
+  setPawnTableSize(m_pawnTableSize);
+  setEvalCacheSize(m_evalCacheSize);
+
+  if (threads > 1)
+    m_helpers = std::make_unique<CThreadPool>(threads - 1);
+}
+
+
+void CSearchPool::setOptions(const SearchOptions &options) {
+  m_options = options;
+
+  for (auto &search: m_searches)
+    search->setOptions(options);
+}
+
+
+void CSearchPool::setPawnTableSize(size_t megabytes) {
+  m_pawnTableSize = megabytes;
+
+  for (auto &search: m_searches)
+    search->pawnTable().resize(megabytes);
+}
+
+
+void CSearchPool::setEvalCacheSize(size_t megabytes) {
+  m_evalCacheSize = megabytes;
+
+  for (auto &search: m_searches)
+    search->evalCache().resize(megabytes);
+}
+
+
+void CSearchPool::clearEvalCaches() {
+  for (auto &search: m_searches)
+    search->evalCache().clear();
+}
+
+
+void CSearchPool::setInfoCallback(std::function<void(const SearchResult &)> callback) {
+  m_infoCallback = std::move(callback);
+
+  if (!m_infoCallback) {
+    m_searches[0]->setInfoCallback(nullptr);
+    return;
+  }
+
+  m_searches[0]->setInfoCallback([this](const SearchResult &result) {
+    SearchResult info = result;
+    info.nodes = 0;
+
+    for (auto &search: m_searches)
+      info.nodes += search->nodes();
+
+    m_infoCallback(info);
+  });
+}
+
+
+void CSearchPool::prepare(const SearchLimits &limits) {
+  m_stop.store(false, std::memory_order_relaxed);
+  m_ponder.store(limits.ponder, std::memory_order_relaxed);
+  m_nodes.store(0, std::memory_order_relaxed);
+}
+
+
+SearchResult CSearchPool::search(const CBoard &board, const SearchLimits &limits, bool prepared) {
+  if (!prepared)
+    prepare(limits);
+
+  // Helpers run until the main thread is done, only the depth limit and the root moves apply to them. The main
+  // thread checks the node limit against the nodes of all threads.
+  SearchLimits helperLimits;
+  helperLimits.depth = limits.depth;
+  helperLimits.searchMoves = limits.searchMoves;
+
+  // The generation is read by every thread, so it changes before any of them starts
+  m_tt.newSearch();
+
+  std::vector<SearchResult> results(m_searches.size());
+
+  for (auto &search: m_searches)
+    search->setPosition(board);
+
+  for (size_t i = 1; i < m_searches.size(); ++i)
+    m_helpers->submit([this, i, &results, helperLimits] {
+      results[i] = m_searches[i]->think(helperLimits);
+    });
+
+  results[0] = m_searches[0]->think(limits);
+
+  stop();
+  if (m_helpers)
+    m_helpers->wait();
+
+  return vote(results);
+}
+
+
+SearchResult CSearchPool::vote(const std::vector<SearchResult> &results) {
+  int minScore = CSearch::INFINITE;
+  uint64_t nodes = 0, pawnHits = 0, pawnMisses = 0, evalHits = 0, evalMisses = 0, tbHits = 0;
+
+  for (const SearchResult &result: results) {
+    nodes += result.nodes;
+    pawnHits += result.pawnHits;
+    pawnMisses += result.pawnMisses;
+    evalHits += result.evalHits;
+    evalMisses += result.evalMisses;
+    tbHits += result.tbHits;
+    if (result.depth > 0 && result.score < minScore)
+      minScore = result.score;
+  }
+
+  // The main thread's move stands unless helpers agree on something else
+  SearchResult best = results[0];
+  int64_t bestVotes = -1;
+
+  for (const SearchResult &candidate: results) {
+    if (candidate.depth == 0)
+      continue;
+
+    int64_t votes = 0;
+    for (const SearchResult &result: results)
+      if (result.depth > 0 && result.bestMove == candidate.bestMove)
+        votes += static_cast<int64_t>(result.score - minScore + 1) * result.depth;
+
+    // Among threads agreeing on the move the deepest one reports the score
+    if (votes > bestVotes || (votes == bestVotes && candidate.depth > best.depth)) {
+      best = candidate;
+      bestVotes = votes;
+    }
+  }
+
+  best.nodes = nodes;
+  best.timeMs = results[0].timeMs;
+  best.pawnHits = pawnHits;
+  best.pawnMisses = pawnMisses;
+  best.evalHits = evalHits;
+  best.evalMisses = evalMisses;
+  best.tbHits = tbHits;
+  return best;
+}
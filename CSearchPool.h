@@ -0,0 +1,76 @@
+//
+// Created by Petr Smerda on 19.09.2024.
+//
+
+#ifndef SFML_CHESS_CSEARCHPOOL_H
+#define SFML_CHESS_CSEARCHPOOL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "CBoard.h"
+#include "CSearch.h"
+#include "CThreadPool.h"
+#include "CTranspositionTable.h"
+
+
+// Lazy SMP: every thread runs its own iterative deepening on a copy of the position, they cooperate only through
+// the shared transposition table. The calling thread is the main one and the only one checking the limits.
+class CSearchPool {
+public:
+  // 0 threads means one per core
+  explicit CSearchPool(CTranspositionTable &tt, int threads = 1);
+
+  void setThreads(int threads);
+
+  int threads() const { return static_cast<int>(m_searches.size()); }
+
+  void setOptions(const SearchOptions &options);
+
+  // Size of the pawn table of every thread
+  void setPawnTableSize(size_t megabytes);
+
+  // Size of the evaluation cache of every thread
+  void setEvalCacheSize(size_t megabytes);
+
+  // Drops the cached evaluations of every thread, needed when the evaluation changes between networks and the
+  // handcrafted one
+  void clearEvalCaches();
+
+  // Clears the stop and ponder flags for the next search. A caller starting the search on another thread calls it
+  // first, so a stop or ponderhit coming before that thread reaches search() is not lost.
+  void prepare(const SearchLimits &limits);
+
+  // Blocks until the limits are reached or stop() is called, then combines the results of all threads. Calls
+  // prepare() itself unless told it was done already.
+  SearchResult search(const CBoard &board, const SearchLimits &limits, bool prepared = false);
+
+  // Safe to call from any thread
+  void stop() { m_stop.store(true, std::memory_order_relaxed); }
+
+  // The opponent played the move pondered on, the time limit of the search applies from now on
+  void ponderhit() { m_ponder.store(false, std::memory_order_relaxed); }
+
+  // Called from the main search thread after every completed iteration, with the nodes of all threads
+  void setInfoCallback(std::function<void(const SearchResult &)> callback);
+
+private:
+  // Picks the move with most support, a thread votes with its depth and by how much its score beats the worst one
+  static SearchResult vote(const std::vector<SearchResult> &results);
+
+  CTranspositionTable &m_tt;
+  std::atomic<bool> m_stop{false};
+  std::atomic<bool> m_ponder{false};
+  std::atomic<uint64_t> m_nodes{0};
+  std::function<void(const SearchResult &)> m_infoCallback;
+  SearchOptions m_options;
+  size_t m_pawnTableSize = 1;
+  size_t m_evalCacheSize = 1;
+
+  std::vector<std::unique_ptr<CSearch>> m_searches;
+  std::unique_ptr<CThreadPool> m_helpers;
+};
+
+
+#endif //SFML_CHESS_CSEARCHPOOL_H
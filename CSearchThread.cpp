@@ -0,0 +1,88 @@
+//
+// Created by Petr Smerda on 09.10.2024.
+//
+
+#include "CSearchThread.h"
+
+
+CSearchThread::CSearchThread(size_t hashMegabytes, int threads) : m_tt(hashMegabytes), m_pool(m_tt, threads) {
+  m_pool.setInfoCallback([this](const SearchResult &info) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_progress = info;
+    }
+
+    if (m_onInfo)
+      m_onInfo(info);
+  });
+}
+
+
+CSearchThread::~CSearchThread() {
+  stop();
+  wait();
+}
+
+
+void CSearchThread::start(const CBoard &board, const SearchLimits &limits) {
+  stop();
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_progress = SearchResult();
+    m_finished = false;
+  }
+
+  // The flags are cleared here rather than on the worker, so a stop or ponderhit right after start() is kept
+  m_pool.prepare(limits);
+  m_running.store(true, std::memory_order_release);
+
+  m_thread = std::thread([this, board, limits] {
+    SearchResult result = m_pool.search(board, limits, true);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_progress = result;
+      m_result = result;
+      m_finished = true;
+      m_running.store(false, std::memory_order_release);
+    }
+
+    if (m_onDone)
+      m_onDone(result);
+  });
+}
+
+
+void CSearchThread::stop() {
+  m_pool.stop();
+}
+
+
+void CSearchThread::ponderhit() {
+  m_pool.ponderhit();
+}
+
+
+void CSearchThread::wait() {
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+
+SearchResult CSearchThread::progress() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_progress;
+}
+
+
+bool CSearchThread::poll(SearchResult &result) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_finished)
+    return false;
+
+  result = m_result;
+  m_finished = false;
+  return true;
+}
@@ -0,0 +1,77 @@
+//
+// Created by Petr Smerda on 09.10.2024.
+//
+
+#ifndef SFML_CHESS_CSEARCHTHREAD_H
+#define SFML_CHESS_CSEARCHTHREAD_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "CBoard.h"
+#include "CSearchPool.h"
+#include "CTranspositionTable.h"
+
+
+// Runs the search pool in the background, so a window or an input loop stays responsive. Every search works on its
+// own copy of the board; the caller polls for the progress and the final result instead of blocking.
+class CSearchThread {
+public:
+  // 0 threads means one per core
+  explicit CSearchThread(size_t hashMegabytes = 64, int threads = 0);
+
+  ~CSearchThread();
+
+  CSearchThread(const CSearchThread &) = delete;
+
+  CSearchThread &operator=(const CSearchThread &) = delete;
+
+  // Settings of the pool may be changed only while no search is running
+  CSearchPool &pool() { return m_pool; }
+
+  CTranspositionTable &tt() { return m_tt; }
+
+  // Called from the search thread with every completed iteration, and with the final result, which poll() returns as
+  // well. Set them while no search is running.
+  void setInfoCallback(std::function<void(const SearchResult &)> callback) { m_onInfo = std::move(callback); }
+
+  void setDoneCallback(std::function<void(const SearchResult &)> callback) { m_onDone = std::move(callback); }
+
+  // Starts searching a copy of the board, a search still running is stopped and its result dropped
+  void start(const CBoard &board, const SearchLimits &limits);
+
+  // Returns at once, the search ends within a few thousand nodes and its result comes from poll()
+  void stop();
+
+  void ponderhit();
+
+  // Waits for the running search to end, without stopping it
+  void wait();
+
+  bool running() const { return m_running.load(std::memory_order_acquire); }
+
+  // Last completed iteration of the current search, depth 0 before the first one
+  SearchResult progress() const;
+
+  // True once for every search that ended, with its final result
+  bool poll(SearchResult &result);
+
+private:
+  CTranspositionTable m_tt;
+  CSearchPool m_pool;
+  std::thread m_thread;
+
+  std::atomic<bool> m_running{false};
+
+  std::function<void(const SearchResult &)> m_onInfo;
+  std::function<void(const SearchResult &)> m_onDone;
+
+  mutable std::mutex m_mutex;
+  SearchResult m_progress;
+  SearchResult m_result;
+  bool m_finished = false;
+};
+
+
+#endif //SFML_CHESS_CSEARCHTHREAD_H
@@ -0,0 +1,528 @@
+//
+// Created by Petr Smerda on 04.10.2024.
+//
+
+#include "CTablebase.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+std::unordered_map<uint32_t, CTablebase::Table> CTablebase::m_tables;
+int CTablebase::m_maxPieces = 0;
+
+
+namespace {
+
+const std::string PIECE_ORDER = "QRBN";
+const int PIECE_VALUES[4] = {9, 5, 3, 3};
+const char MAGIC[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '2'};
+
+// Bit 0 mirrors the files, bit 1 the ranks, bit 2 swaps files and ranks
+int transform(int square, int symmetry) {
+  int file = square % 8, rank = square / 8;
+
+  if (symmetry & 1)
+    file = 7 - file;
+  if (symmetry & 2)
+    rank = 7 - rank;
+  if (symmetry & 4)
+    std::swap(file, rank);
+
+  return rank * 8 + file;
+}
+
+// Placements of the kings left by the 8 symmetries of a pawnless board
+constexpr int KING_PAIRS = 462;
+
+const int TRIANGLE_SQUARES[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+// The white king is in the a1-d1-d4 triangle, the black king on another square not next to it. With the white king
+// on the a1-h8 diagonal the black king is on or below it, the other half is its mirror image.
+struct KingPairs {
+  int16_t index[64][64];  // -1 for the other placements
+  uint8_t squares[KING_PAIRS][2];
+  uint8_t symmetries[64][64];  // Bit s is set when the symmetry s brings the kings to a pair
+
+  KingPairs() : index(), squares(), symmetries() {
+    std::fill(&index[0][0], &index[0][0] + 64 * 64, -1);
+    int count = 0;
+
+    for (int white: TRIANGLE_SQUARES)
+      for (int black = 0; black < 64; ++black) {
+        int files = std::abs(white % 8 - black % 8), ranks = std::abs(white / 8 - black / 8);
+        if ((files <= 1 && ranks <= 1) || (white % 8 == white / 8 && black / 8 > black % 8))
+          continue;
+
+        index[white][black] = static_cast<int16_t>(count);
+        squares[count][0] = static_cast<uint8_t>(white);
+        squares[count][1] = static_cast<uint8_t>(black);
+        count++;
+      }
+
+    for (int white = 0; white < 64; ++white)
+      for (int black = 0; black < 64; ++black)
+        for (int symmetry = 0; symmetry < 8; ++symmetry)
+          if (index[transform(white, symmetry)][transform(black, symmetry)] >= 0)
+            symmetries[white][black] |= 1 << symmetry;
+  }
+};
+
+const KingPairs kingPairs;
+
+// Ways to choose k of n squares, equal pieces take one combination of squares instead of one square each
+struct Binomials {
+  uint64_t value[65][CTablebase::MAX_PIECES + 1];
+
+  Binomials() : value() {
+    for (int n = 0; n <= 64; ++n) {
+      value[n][0] = 1;
+      for (int k = 1; k <= CTablebase::MAX_PIECES && k <= n; ++k)
+        value[n][k] = value[n - 1][k - 1] + value[n - 1][k];
+    }
+  }
+};
+
+const Binomials binomials;
+
+int sideValue(const std::string &pieces) {
+  int value = 0;
+  for (char piece: pieces)
+    value += PIECE_VALUES[PIECE_ORDER.find(piece)];
+
+  return value;
+}
+
+// Sizes of the runs of same pieces, white ones first; the pieces of a run are interchangeable
+int pieceGroups(const CTablebase::Material &material, int *sizes) {
+  int count = 0;
+
+  for (const std::string *pieces: {&material.white, &material.black})
+    for (size_t start = 0, end; start < pieces->size(); start = end) {
+      end = start;
+      while (end < pieces->size() && (*pieces)[end] == (*pieces)[start])
+        end++;
+
+      sizes[count++] = static_cast<int>(end - start);
+    }
+
+  return count;
+}
+
+// Index of the placement with the kings already on a pair of the table. Each group is a combination of the squares
+// not taken by the pieces before it, numbered by the combinatorial number system.
+uint64_t encode(const int *sizes, int groups, const int *squares) {
+  uint64_t index = kingPairs.index[squares[0]][squares[1]];
+  Bitboard occupied = (1ULL << squares[0]) | (1ULL << squares[1]);
+  int free = 62;
+
+  for (int group = 0, slot = 2; group < groups; slot += sizes[group++]) {
+    int size = sizes[group];
+    int sorted[CTablebase::MAX_PIECES];
+    std::copy(squares + slot, squares + slot + size, sorted);
+    for (int i = 1; i < size; ++i)
+      for (int j = i; j > 0 && sorted[j - 1] > sorted[j]; --j)
+        std::swap(sorted[j - 1], sorted[j]);
+
+    uint64_t combination = 0;
+    for (int i = 0; i < size; ++i)
+      combination += binomials.value[sorted[i] - CBoard::popcount(occupied & ((1ULL << sorted[i]) - 1))][i + 1];
+
+    index = index * binomials.value[free][size] + combination;
+    for (int i = 0; i < size; ++i)
+      occupied |= 1ULL << sorted[i];
+    free -= size;
+  }
+
+  return index;
+}
+
+// The n-th empty square counted from a1, every occupied square up to it moves it one further
+int emptySquare(Bitboard occupied, int n) {
+  int square = n;
+  for (; occupied; occupied &= occupied - 1)
+    if (__builtin_ctzll(occupied) <= square)
+      square++;
+
+  return square;
+}
+
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Material                            *
+ *                      Material                            *
+ *                                                          *
+ ************************************************************
+ */
+
+
+uint32_t CTablebase::Material::code() const {
+  // Three bits for the count of every piece type of every side
+  uint32_t code = 0;
+
+  for (char piece: white)
+    code += 1U << (3 * PIECE_ORDER.find(piece));
+  for (char piece: black)
+    code += 1U << (12 + 3 * PIECE_ORDER.find(piece));
+
+  return code;
+}
+
+
+CTablebase::Material CTablebase::Material::make(std::string white, std::string black, bool &swapped) {
+  auto byOrder = [](char a, char b) { return PIECE_ORDER.find(a) < PIECE_ORDER.find(b); };
+  std::sort(white.begin(), white.end(), byOrder);
+  std::sort(black.begin(), black.end(), byOrder);
+
+  // Equal values are decided by the pieces themselves, the side with the earlier ones in QRBN order is stronger
+  int whiteValue = sideValue(white), blackValue = sideValue(black);
+  swapped = blackValue > whiteValue ||
+            (blackValue == whiteValue && std::lexicographical_compare(black.begin(), black.end(), white.begin(),
+                                                                      white.end(), byOrder));
+
+  return swapped ? Material{black, white} : Material{white, black};
+}
+
+
+bool CTablebase::Material::parse(const std::string &name, Material &material) {
+  size_t separator = name.find('v');
+  if (separator == std::string::npos || name.size() > MAX_PIECES + 1 || name[0] != 'K' ||
+      separator + 1 >= name.size() || name[separator + 1] != 'K')
+    return false;
+
+  std::string white = name.substr(1, separator - 1);
+  std::string black = name.substr(separator + 2);
+
+  for (char piece: white + black)
+    if (PIECE_ORDER.find(piece) == std::string::npos)
+      return false;
+
+  bool swapped;
+  material = make(white, black, swapped);
+  return true;
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Indexing                            *
+ *                      Indexing                            *
+ *                                                          *
+ ************************************************************
+ */
+
+
+uint64_t CTablebase::entriesPerSide(const Material &material) {
+  int sizes[MAX_PIECES];
+  int groups = pieceGroups(material, sizes);
+
+  uint64_t entries = KING_PAIRS;
+  for (int group = 0, free = 62; group < groups; free -= sizes[group++])
+    entries *= binomials.value[free][sizes[group]];
+
+  return entries;
+}
+
+
+uint64_t CTablebase::index(const Material &material, const Position &position) {
+  int pieces = material.pieces();
+  int sizes[MAX_PIECES];
+  int groups = pieceGroups(material, sizes);
+  uint64_t best = NO_ENTRY;
+
+  // Usually a single symmetry gives a pair of the table, with both kings on the diagonal there are two
+  for (int symmetries = kingPairs.symmetries[position.squares[0]][position.squares[1]]; symmetries;
+       symmetries &= symmetries - 1) {
+    int symmetry = __builtin_ctz(symmetries);
+    int squares[MAX_PIECES];
+    for (int i = 0; i < pieces; ++i)
+      squares[i] = transform(position.squares[i], symmetry);
+
+    best = std::min(best, encode(sizes, groups, squares));
+  }
+
+  return best;
+}
+
+
+void CTablebase::decode(const Material &material, uint64_t index, Position &position) {
+  int sizes[MAX_PIECES];
+  int groups = pieceGroups(material, sizes);
+
+  // Mixed radix, the last group is the lowest digit
+  int free[MAX_PIECES];
+  for (int group = 0, squares = 62; group < groups; squares -= sizes[group++])
+    free[group] = squares;
+
+  uint64_t combinations[MAX_PIECES];
+  for (int group = groups - 1; group >= 0; --group) {
+    uint64_t radix = binomials.value[free[group]][sizes[group]];
+    combinations[group] = index % radix;
+    index /= radix;
+  }
+
+  position.squares[0] = kingPairs.squares[index][0];
+  position.squares[1] = kingPairs.squares[index][1];
+  Bitboard occupied = (1ULL << position.squares[0]) | (1ULL << position.squares[1]);
+
+  for (int group = 0, slot = 2; group < groups; slot += sizes[group++]) {
+    int size = sizes[group];
+    uint64_t combination = combinations[group];
+    Bitboard taken = occupied;
+
+    // The largest square first, each one is the greatest with its binomial still within the rest. A single piece is
+    // its own combination.
+    for (int i = size, empty = size == 1 ? static_cast<int>(combination) : free[group] - 1; i > 0; --i) {
+      while (binomials.value[empty][i] > combination)
+        empty--;
+
+      combination -= binomials.value[empty][i];
+      position.squares[slot + i - 1] = emptySquare(occupied, empty);
+      taken |= 1ULL << position.squares[slot + i - 1];
+      empty--;
+    }
+
+    occupied = taken;
+  }
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Probing                             *
+ *                      Probing                             *
+ *                                                          *
+ ************************************************************
+ */
+
+
+bool CTablebase::probe(const Piece *pieces, int count, bool whiteToMove, int &wdl, int &dtz) {
+  if (count > MAX_PIECES)
+    return false;
+
+  std::string white, black;
+  for (int i = 0; i < count; ++i) {
+    if (pieces[i].type == 'P')
+      return false;
+    if (pieces[i].type != 'K')
+      (pieces[i].isWhite ? white : black) += pieces[i].type;
+  }
+
+  bool swapped;
+  Material material = Material::make(white, black, swapped);
+
+  // Bare kings
+  if (material.pieces() == 2) {
+    wdl = WDL_DRAW;
+    dtz = 0;
+    return true;
+  }
+
+  auto table = m_tables.find(material.code());
+  if (table == m_tables.end())
+    return false;
+
+  // The table's white is black on the board when the colours were exchanged, the board is then turned upside down
+  bool used[MAX_PIECES] = {};
+  auto take = [&](char type, bool isWhite) {
+    for (int i = 0; i < count; ++i)
+      if (!used[i] && pieces[i].type == type && pieces[i].isWhite == (isWhite != swapped)) {
+        used[i] = true;
+        return swapped ? pieces[i].square ^ 56 : pieces[i].square;
+      }
+    return 0;
+  };
+
+  Position position = {};
+  int slot = 0;
+  position.squares[slot++] = take('K', true);
+  position.squares[slot++] = take('K', false);
+  for (char piece: material.white)
+    position.squares[slot++] = take(piece, true);
+  for (char piece: material.black)
+    position.squares[slot++] = take(piece, false);
+  position.whiteToMove = whiteToMove != swapped;
+
+  uint64_t entry = index(material, position);
+  if (entry == NO_ENTRY)
+    return false;
+
+  entry += position.whiteToMove ? 0 : table->second.entries;
+  wdl = (table->second.wdl[entry / 4] >> (entry % 4 * 2)) & 3;
+  dtz = table->second.dtz[entry];
+
+  return wdl != WDL_NONE;
+}
+
+
+bool CTablebase::boardPieces(const CBoard &board, Piece pieces[MAX_PIECES], int &count) {
+  if (board.pieceCount() > m_maxPieces || board.hasCastlingRights())
+    return false;
+
+  count = 0;
+  for (char type: std::string("KQRBNP"))
+    for (bool isWhite: {true, false})
+      for (auto square: CBitboardRange(board.pieces(type, isWhite)))
+        pieces[count++] = {type, isWhite, __builtin_ctzll(square)};
+
+  return true;
+}
+
+
+bool CTablebase::probe(const CBoard &board, int &wdl, int &dtz) {
+  Piece pieces[MAX_PIECES];
+  int count;
+
+  return boardPieces(board, pieces, count) && probe(pieces, count, board.whiteToMove(), wdl, dtz);
+}
+
+
+bool CTablebase::probeWdl(const CBoard &board, int &wdl) {
+  int dtz;
+  return probe(board, wdl, dtz);
+}
+
+
+bool CTablebase::probeRoot(CBoard &board, CMove &move, int &wdl, int &dtz) {
+  if (!probe(board, wdl, dtz))
+    return false;
+
+  CMoveList moves;
+  board.generateMoves(moves);
+
+  int bestRank = -1;
+
+  for (CMove candidate: moves) {
+    int childWdl, childDtz;
+
+    board.makeMove(candidate);
+    bool found = probe(board, childWdl, childDtz);
+    board.unmakeMove();
+
+    // A capture into an ending without a table, the search has to decide
+    if (!found)
+      return false;
+
+    int result = childWdl == WDL_LOSS ? WDL_WIN : childWdl == WDL_WIN ? WDL_LOSS : WDL_DRAW;
+    if (result != wdl)
+      continue;
+
+    // Plies until the next capture or mate after this move
+    int rank = childWdl == WDL_LOSS && childDtz == 0 ? 0 : candidate.isCapture() ? 1 : childDtz + 1;
+
+    if (bestRank < 0 || (wdl == WDL_WIN && rank < bestRank) || (wdl == WDL_LOSS && rank > bestRank)) {
+      bestRank = rank;
+      move = candidate;
+    }
+  }
+
+  return bestRank >= 0;
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Files                               *
+ *                      Files                               *
+ *                                                          *
+ ************************************************************
+ */
+
+
+void *CTablebase::mapFile(const std::string &path, size_t &size, uint64_t &entries) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_SIZE) {
+    close(fd);
+    return nullptr;
+  }
+
+  size = info.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+    return nullptr;
+
+  if (std::memcmp(mapping, MAGIC, sizeof(MAGIC)) != 0) {
+    munmap(mapping, size);
+    return nullptr;
+  }
+
+  std::memcpy(&entries, static_cast<const uint8_t *>(mapping) + sizeof(MAGIC), sizeof(entries));
+  return mapping;
+}
+
+
+bool CTablebase::load(const std::string &directory, const Material &material) {
+  std::string path = directory + "/" + material.name();
+  uint64_t entries = entriesPerSide(material), wdlEntries = 0, dtzEntries = 0;
+
+  Table table = {};
+  table.entries = entries;
+  table.wdlMapping = mapFile(path + ".wdl", table.wdlSize, wdlEntries);
+  table.dtzMapping = mapFile(path + ".dtz", table.dtzSize, dtzEntries);
+
+  if (!table.wdlMapping || !table.dtzMapping || wdlEntries != entries || dtzEntries != entries ||
+      table.wdlSize != HEADER_SIZE + (2 * entries + 3) / 4 || table.dtzSize != HEADER_SIZE + 2 * entries) {
+    if (table.wdlMapping)
+      munmap(table.wdlMapping, table.wdlSize);
+    if (table.dtzMapping)
+      munmap(table.dtzMapping, table.dtzSize);
+    return false;
+  }
+
+  table.wdl = static_cast<const uint8_t *>(table.wdlMapping) + HEADER_SIZE;
+  table.dtz = static_cast<const uint8_t *>(table.dtzMapping) + HEADER_SIZE;
+
+  auto previous = m_tables.find(material.code());
+  if (previous != m_tables.end()) {
+    munmap(previous->second.wdlMapping, previous->second.wdlSize);
+    munmap(previous->second.dtzMapping, previous->second.dtzSize);
+  }
+
+  m_tables[material.code()] = table;
+  m_maxPieces = std::max(m_maxPieces, material.pieces());
+  return true;
+}
+
+
+int CTablebase::init(const std::string &directory) {
+  std::error_code error;
+  int loaded = 0;
+
+  for (const auto &file: std::filesystem::directory_iterator(directory, error)) {
+    Material material;
+    if (file.path().extension() == ".wdl" && Material::parse(file.path().stem().string(), material) &&
+        load(directory, material))
+      loaded++;
+  }
+
+  return loaded;
+}
+
+
+void CTablebase::clear() {
+  for (auto &[code, table]: m_tables) {
+    munmap(table.wdlMapping, table.wdlSize);
+    munmap(table.dtzMapping, table.dtzSize);
+  }
+
+  m_tables.clear();
+  m_maxPieces = 0;
+}
@@ -0,0 +1,133 @@
+//
+// Created by Petr Smerda on 04.10.2024.
+//
+
+#ifndef SFML_CHESS_CTABLEBASE_H
+#define SFML_CHESS_CTABLEBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "CBoard.h"
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                  Endgame tablebases                      *
+ *                  Endgame tablebases                      *
+ *                                                          *
+ ************************************************************
+ */
+
+// Perfect play for pawnless endings of up to MAX_PIECES pieces, generated locally by CTablebaseGenerator.
+// Every ending has two files named after its material, e.g. KQvKR.wdl and KQvKR.dtz, each starting with a 16 byte
+// header ("CHESSTB2" and the number of entries per side) followed by the white to move and black to move halves:
+//   .wdl  2 bits per position, 4 to a byte: draw, win or loss for the side to move, or not a position
+//   .dtz  1 byte per position: plies to the next capture or mate with best play, 255 if longer
+// Pieces are ordered as white king, black king, white pieces, black pieces, the others in QRBN order. The 8 symmetries
+// of a pawnless board bring the kings to one of 462 pairs with the white king in the a1-d1-d4 triangle, each run of
+// same pieces is then a combination of the squares still empty, so an ending of n pieces has at most
+// 462 * 62 * ... * (65 - n) entries per side. Among symmetric placements the smallest index is used.
+// The 50-move rule is not taken into account, a win is a win however long it takes.
+class CTablebase {
+public:
+  static constexpr int MAX_PIECES = 5;
+
+  enum Wdl {
+    WDL_DRAW = 0,
+    WDL_WIN = 1,
+    WDL_LOSS = 2,
+    WDL_NONE = 3,  // Illegal or duplicate placement
+  };
+
+  // Pieces of both sides, white first, each side in QRBN order without the king
+  struct Material {
+    std::string white;
+    std::string black;
+
+    std::string name() const { return "K" + white + "vK" + black; }
+
+    int pieces() const { return static_cast<int>(2 + white.size() + black.size()); }
+
+    uint32_t code() const;
+
+    // Sorts both sides and makes the stronger one white, swapped tells whether the colours had to be exchanged
+    static Material make(std::string white, std::string black, bool &swapped);
+
+    // Parses "KQvKR"
+    static bool parse(const std::string &name, Material &material);
+  };
+
+  // Placement in index order: white king, black king, white pieces, black pieces
+  struct Position {
+    int squares[MAX_PIECES];
+    bool whiteToMove;
+  };
+
+  struct Piece {
+    char type;
+    bool isWhite;
+    int square;
+  };
+
+  // Maps every table found in the directory, returns how many there are
+  static int init(const std::string &directory);
+
+  static void clear();
+
+  // Largest number of pieces with a table loaded, 0 without tables
+  static int maxPieces() { return m_maxPieces; }
+
+  // Result for the side to move; false when the position has no table (pawns, castling rights, too many pieces)
+  static bool probeWdl(const CBoard &board, int &wdl);
+
+  static bool probe(const CBoard &board, int &wdl, int &dtz);
+
+  // Best root move by distance to zeroing: the fastest win, any draw or the slowest loss; dtz is the root's own
+  static bool probeRoot(CBoard &board, CMove &move, int &wdl, int &dtz);
+
+  // Any placement of pieces, kings included; colours are exchanged here when black is the stronger side
+  static bool probe(const Piece *pieces, int count, bool whiteToMove, int &wdl, int &dtz);
+
+  // Generator interface, positions of the given material with colours as in the table
+
+  static constexpr uint64_t NO_ENTRY = UINT64_MAX;
+
+  static uint64_t entriesPerSide(const Material &material);
+
+  // Entry of the position, it may be a transformed copy of the given one; NO_ENTRY when the kings touch
+  static uint64_t index(const Material &material, const Position &position);
+
+  static void decode(const Material &material, uint64_t index, Position &position);
+
+  static bool hasTable(const Material &material) { return m_tables.count(material.code()) > 0; }
+
+  // Maps the two files of one ending
+  static bool load(const std::string &directory, const Material &material);
+
+private:
+  struct Table {
+    uint64_t entries;  // Per side
+    const uint8_t *wdl;
+    const uint8_t *dtz;
+    void *wdlMapping;
+    void *dtzMapping;
+    size_t wdlSize;
+    size_t dtzSize;
+  };
+
+  static constexpr size_t HEADER_SIZE = 16;
+
+  static bool boardPieces(const CBoard &board, Piece pieces[MAX_PIECES], int &count);
+
+  // Whole file mapped, entries read from the header; nullptr if it is not a table
+  static void *mapFile(const std::string &path, size_t &size, uint64_t &entries);
+
+  static std::unordered_map<uint32_t, Table> m_tables;
+  static int m_maxPieces;
+};
+
+
+#endif //SFML_CHESS_CTABLEBASE_H
@@ -0,0 +1,414 @@
+//
+// Created by Petr Smerda on 05.10.2024.
+//
+
+#include "CTablebaseGenerator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <set>
+
+
+namespace {
+
+constexpr uint64_t CHUNK = 1 << 14;
+constexpr uint16_t UNDECIDED = 0xFFFF;
+
+// Non-sliding attacks, the sliders come from CAttacks
+struct StepAttacks {
+  Bitboard king[64];
+  Bitboard knight[64];
+
+  StepAttacks() : king(), knight() {
+    const int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+
+    for (int square = 0; square < 64; ++square)
+      for (int i = 0; i < 8; ++i) {
+        int file = square % 8 + kingSteps[i][0], rank = square / 8 + kingSteps[i][1];
+        if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+          king[square] |= 1ULL << (rank * 8 + file);
+
+        file = square % 8 + knightSteps[i][0], rank = square / 8 + knightSteps[i][1];
+        if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+          knight[square] |= 1ULL << (rank * 8 + file);
+      }
+  }
+};
+
+const StepAttacks steps;
+
+Bitboard attacks(char type, int square, Bitboard occupied) {
+  switch (type) {
+    case 'K': return steps.king[square];
+    case 'N': return steps.knight[square];
+    case 'B': return CAttacks::bishopAttacks(square, occupied);
+    case 'R': return CAttacks::rookAttacks(square, occupied);
+    default: return CAttacks::queenAttacks(square, occupied);
+  }
+}
+
+template<typename T>
+std::atomic_ref<T> atomic(T &value) {
+  return std::atomic_ref<T>(value);
+}
+
+}
+
+
+CTablebaseGenerator::CTablebaseGenerator(std::string directory, int threads)
+        : m_directory(std::move(directory)), m_pool(std::max(1, threads)) {
+  CAttacks::init();
+}
+
+
+void CTablebaseGenerator::parallelFor(uint64_t count, const std::function<void(uint64_t, uint64_t)> &function) {
+  for (uint64_t begin = 0; begin < count; begin += CHUNK)
+    m_pool.submit([&function, begin, end = std::min(count, begin + CHUNK)] { function(begin, end); });
+
+  m_pool.wait();
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                  Retrograde analysis                     *
+ *                  Retrograde analysis                     *
+ *                                                          *
+ ************************************************************
+ */
+
+
+namespace {
+
+// Whether a piece of the given colour attacks the square, skip is a piece just captured
+bool attacked(int square, bool byWhite, const char *types, const bool *whites, const int *squares, int pieces,
+              Bitboard occupied, int skip) {
+  for (int i = 0; i < pieces; ++i)
+    if (whites[i] == byWhite && i != skip && (attacks(types[i], squares[i], occupied) & (1ULL << square)))
+      return true;
+
+  return false;
+}
+
+// Removes duplicates, symmetric positions reach the same entry by different moves
+int unique(uint64_t *indices, int count) {
+  std::sort(indices, indices + count);
+  return static_cast<int>(std::unique(indices, indices + count) - indices);
+}
+
+}
+
+
+void CTablebaseGenerator::initEntry(Tables &tables, uint64_t entry) {
+  bool whiteToMove = entry < tables.entries;
+  uint64_t index = entry % tables.entries;
+  int pieces = tables.pieces;
+
+  CTablebase::Position position;
+  CTablebase::decode(tables.material, index, position);
+  int *squares = position.squares;
+
+  Bitboard occupied = 0, own = 0;
+  for (int i = 0; i < pieces; ++i) {
+    occupied |= 1ULL << squares[i];
+    if (tables.whites[i] == whiteToMove)
+      own |= 1ULL << squares[i];
+  }
+
+  int ownKing = whiteToMove ? 0 : 1;
+  int enemyKing = 1 - ownKing;
+
+  // The side not to move in check, or the entry of a symmetric placement on the diagonal
+  if (attacked(squares[enemyKing], whiteToMove, tables.types, tables.whites, squares, pieces, occupied, -1) ||
+      CTablebase::index(tables.material, position) != index) {
+    tables.state[entry] = INVALID;
+    return;
+  }
+
+  bool inCheck = attacked(squares[ownKing], !whiteToMove, tables.types, tables.whites, squares, pieces, occupied, -1);
+  bool winningCapture = false;
+  int moves = 0, drawingCaptures = 0, childCount = 0;
+  uint64_t children[128];
+
+  for (int i = 0; i < pieces; ++i) {
+    if (tables.whites[i] != whiteToMove)
+      continue;
+
+    int from = squares[i];
+
+    for (auto target: CBitboardRange(attacks(tables.types[i], from, occupied) & ~own)) {
+      int to = __builtin_ctzll(target);
+      int captured = -1;
+      for (int j = 0; j < pieces; ++j)
+        if (squares[j] == to)
+          captured = j;
+
+      squares[i] = to;
+      Bitboard after = (occupied & ~(1ULL << from)) | target;
+
+      if (!attacked(squares[ownKing], !whiteToMove, tables.types, tables.whites, squares, pieces, after, captured)) {
+        moves++;
+
+        if (captured < 0)
+          children[childCount++] = CTablebase::index(tables.material, position);
+        else {
+          // The result comes from the smaller ending
+          CTablebase::Piece rest[CTablebase::MAX_PIECES];
+          int count = 0;
+          for (int j = 0; j < pieces; ++j)
+            if (j != captured)
+              rest[count++] = {tables.types[j], tables.whites[j], squares[j]};
+
+          int wdl = CTablebase::WDL_DRAW, dtz;
+          CTablebase::probe(rest, count, !whiteToMove, wdl, dtz);
+
+          if (wdl == CTablebase::WDL_LOSS)
+            winningCapture = true;
+          else if (wdl == CTablebase::WDL_DRAW)
+            drawingCaptures++;
+        }
+      }
+
+      squares[i] = from;
+    }
+  }
+
+  // Drawing captures are moves that never turn into a win for the opponent
+  int counter = unique(children, childCount) + drawingCaptures;
+
+  if (moves == 0) {
+    tables.state[entry] = inCheck ? LOSS : DRAW;
+    tables.dtz[entry] = 0;
+  } else if (winningCapture) {
+    tables.state[entry] = WIN;
+    tables.dtz[entry] = 1;
+  } else if (counter == 0) {
+    // Every move is a capture into a lost ending
+    tables.state[entry] = LOSS;
+    tables.dtz[entry] = 1;
+  } else
+    tables.counter[entry] = static_cast<uint8_t>(counter);
+}
+
+
+uint64_t CTablebaseGenerator::propagate(Tables &tables, uint64_t entry, uint16_t dtz) {
+  bool whiteToMove = entry < tables.entries;
+  bool lost = atomic(tables.state[entry]).load(std::memory_order_relaxed) == LOSS;
+  int pieces = tables.pieces;
+
+  CTablebase::Position position;
+  CTablebase::decode(tables.material, entry % tables.entries, position);
+  int *squares = position.squares;
+
+  Bitboard occupied = 0;
+  for (int i = 0; i < pieces; ++i)
+    occupied |= 1ULL << squares[i];
+
+  // The side not to move made the last move, without capturing anything as that would be another ending
+  bool mover = !whiteToMove;
+  int king = whiteToMove ? 0 : 1;
+  int predecessorCount = 0;
+  uint64_t predecessors[128];
+
+  for (int i = 0; i < pieces; ++i) {
+    if (tables.whites[i] != mover)
+      continue;
+
+    int to = squares[i];
+
+    for (auto origin: CBitboardRange(attacks(tables.types[i], to, occupied) & ~occupied)) {
+      squares[i] = __builtin_ctzll(origin);
+      Bitboard before = (occupied & ~(1ULL << to)) | origin;
+
+      // Before the move the side to move now could not have been in check
+      if (!(steps.king[squares[0]] & (1ULL << squares[1])) &&
+          !attacked(squares[king], mover, tables.types, tables.whites, squares, pieces, before, -1))
+        predecessors[predecessorCount++] = CTablebase::index(tables.material, position);
+
+      squares[i] = to;
+    }
+  }
+
+  uint64_t decided = 0;
+  uint64_t offset = mover ? 0 : tables.entries;
+
+  for (int i = 0, count = unique(predecessors, predecessorCount); i < count; ++i) {
+    uint64_t predecessor = offset + predecessors[i];
+    auto state = atomic(tables.state[predecessor]);
+    uint8_t expected = UNKNOWN;
+
+    // A move into a lost position wins, a position is lost once its last move turns out to lose
+    if (lost) {
+      if (!state.compare_exchange_strong(expected, WIN, std::memory_order_relaxed))
+        continue;
+    } else if (state.load(std::memory_order_relaxed) != UNKNOWN ||
+               atomic(tables.counter[predecessor]).fetch_sub(1, std::memory_order_relaxed) != 1 ||
+               !state.compare_exchange_strong(expected, LOSS, std::memory_order_relaxed))
+      continue;
+
+    atomic(tables.dtz[predecessor]).store(dtz, std::memory_order_relaxed);
+    decided++;
+  }
+
+  return decided;
+}
+
+
+bool CTablebaseGenerator::build(const CTablebase::Material &material) {
+  auto start = std::chrono::steady_clock::now();
+
+  Tables tables;
+  tables.material = material;
+  tables.pieces = material.pieces();
+  tables.entries = CTablebase::entriesPerSide(material);
+
+  std::string types = "KK" + material.white + material.black;
+  for (int i = 0; i < tables.pieces; ++i) {
+    tables.types[i] = types[i];
+    tables.whites[i] = i == 0 || (i >= 2 && i < 2 + static_cast<int>(material.white.size()));
+  }
+
+  tables.state.assign(2 * tables.entries, UNKNOWN);
+  tables.dtz.assign(2 * tables.entries, UNDECIDED);
+  tables.counter.assign(2 * tables.entries, 0);
+
+  parallelFor(2 * tables.entries, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t entry = begin; entry < end; ++entry)
+      initEntry(tables, entry);
+  });
+
+  // Mates have distance 0, the first scoring also decides some positions at distance 1 by captures
+  uint16_t dtz = 1;
+  for (; dtz < UNDECIDED; ++dtz) {
+    std::atomic<uint64_t> decided{0};
+
+    parallelFor(2 * tables.entries, [&](uint64_t begin, uint64_t end) {
+      uint64_t count = 0;
+
+      for (uint64_t entry = begin; entry < end; ++entry) {
+        uint8_t state = atomic(tables.state[entry]).load(std::memory_order_relaxed);
+        if ((state == WIN || state == LOSS) && atomic(tables.dtz[entry]).load(std::memory_order_relaxed) == dtz - 1)
+          count += propagate(tables, entry, dtz);
+      }
+
+      decided += count;
+    });
+
+    if (decided == 0 && dtz > 1)
+      break;
+  }
+
+  uint64_t results[5] = {};
+  int longest = 0;
+  for (uint64_t entry = 0; entry < 2 * tables.entries; ++entry) {
+    results[tables.state[entry]]++;
+    if (tables.state[entry] == WIN || tables.state[entry] == LOSS)
+      longest = std::max<int>(longest, tables.dtz[entry]);
+  }
+
+  printf("%-8s  win %llu  loss %llu  draw %llu  longest %d plies  %.1f s\n", material.name().c_str(),
+         static_cast<unsigned long long>(results[WIN]), static_cast<unsigned long long>(results[LOSS]),
+         static_cast<unsigned long long>(results[UNKNOWN] + results[DRAW]), longest,
+         std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+  return write(tables) && CTablebase::load(m_directory, material);
+}
+
+
+bool CTablebaseGenerator::write(const Tables &tables) const {
+  const char magic[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '2'};
+  uint64_t size = 2 * tables.entries;
+
+  std::vector<uint8_t> wdl((size + 3) / 4, 0);
+  std::vector<uint8_t> dtz(size, 0);
+
+  for (uint64_t entry = 0; entry < size; ++entry) {
+    int value = tables.state[entry] == WIN ? CTablebase::WDL_WIN : tables.state[entry] == LOSS ? CTablebase::WDL_LOSS :
+                tables.state[entry] == INVALID ? CTablebase::WDL_NONE : CTablebase::WDL_DRAW;
+    wdl[entry / 4] |= value << (entry % 4 * 2);
+
+    if (tables.state[entry] == WIN || tables.state[entry] == LOSS)
+      dtz[entry] = static_cast<uint8_t>(std::min<int>(tables.dtz[entry], 255));
+  }
+
+  std::string path = m_directory + "/" + tables.material.name();
+
+  for (const auto &[extension, data]: {std::make_pair(".wdl", &wdl), std::make_pair(".dtz", &dtz)}) {
+    std::ofstream file(path + extension, std::ios::binary);
+    file.write(magic, sizeof(magic));
+    file.write(reinterpret_cast<const char *>(&tables.entries), sizeof(tables.entries));
+    file.write(reinterpret_cast<const char *>(data->data()), static_cast<std::streamsize>(data->size()));
+
+    if (!file) {
+      fprintf(stderr, "cannot write %s%s\n", path.c_str(), extension);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+/*
+ ************************************************************
+ *                                                          *
+ *                      Endings                             *
+ *                      Endings                             *
+ *                                                          *
+ ************************************************************
+ */
+
+
+bool CTablebaseGenerator::generate(const CTablebase::Material &material) {
+  if (material.pieces() == 2 || CTablebase::hasTable(material) || CTablebase::load(m_directory, material))
+    return true;
+
+  // Every capture leads to an ending with one piece less
+  for (size_t i = 0; i < material.white.size() + material.black.size(); ++i) {
+    std::string white = material.white, black = material.black;
+    if (i < white.size())
+      white.erase(i, 1);
+    else
+      black.erase(i - white.size(), 1);
+
+    bool swapped;
+    if (!generate(CTablebase::Material::make(white, black, swapped)))
+      return false;
+  }
+
+  return build(material);
+}
+
+
+std::vector<CTablebase::Material> CTablebaseGenerator::allEndings(int pieces) {
+  // Every multiset of QRBN up to the given size
+  std::vector<std::string> sides = {""};
+  for (size_t i = 0; i < sides.size(); ++i)
+    for (char piece: std::string("QRBN"))
+      if (static_cast<int>(sides[i].size()) < pieces - 2 &&
+          (sides[i].empty() || std::string("QRBN").find(piece) >= std::string("QRBN").find(sides[i].back())))
+        sides.push_back(sides[i] + piece);
+
+  std::set<std::string> names;
+  std::vector<CTablebase::Material> endings;
+
+  for (const std::string &white: sides)
+    for (const std::string &black: sides) {
+      int count = static_cast<int>(2 + white.size() + black.size());
+      bool swapped;
+      CTablebase::Material material = CTablebase::Material::make(white, black, swapped);
+
+      if (count > 2 && count <= pieces && names.insert(material.name()).second)
+        endings.push_back(material);
+    }
+
+  std::stable_sort(endings.begin(), endings.end(), [](const CTablebase::Material &a, const CTablebase::Material &b) {
+    return a.pieces() < b.pieces();
+  });
+
+  return endings;
+}
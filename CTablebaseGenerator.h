@@ -0,0 +1,69 @@
+//
+// Created by Petr Smerda on 05.10.2024.
+//
+
+#ifndef SFML_CHESS_CTABLEBASEGENERATOR_H
+#define SFML_CHESS_CTABLEBASEGENERATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "CTablebase.h"
+#include "CThreadPool.h"
+
+
+// Builds the files of CTablebase by retrograde analysis. Every position is first scored from its own moves: mates,
+// stalemates and captures, whose results come from the smaller tables. Then, one ply at a time, the positions decided
+// in the previous round pass their result back to the positions that lead to them by unmaking a move: a loss makes
+// its predecessors wins, and a predecessor all of whose moves lead to wins for the opponent is lost. What is left at
+// the end is a draw.
+class CTablebaseGenerator {
+public:
+  CTablebaseGenerator(std::string directory, int threads);
+
+  // Generates the ending and every smaller one a capture leads to, endings already in the directory are only loaded
+  bool generate(const CTablebase::Material &material);
+
+  // Pawnless endings with the given number of pieces or fewer
+  static std::vector<CTablebase::Material> allEndings(int pieces);
+
+private:
+  // Result while generating, written to the files as CTablebase::Wdl
+  enum State : uint8_t {
+    UNKNOWN,
+    WIN,
+    LOSS,
+    DRAW,
+    INVALID,
+  };
+
+  struct Tables {
+    CTablebase::Material material;
+    int pieces;
+    char types[CTablebase::MAX_PIECES];
+    bool whites[CTablebase::MAX_PIECES];
+    uint64_t entries;                  // Per side, white to move first
+    std::vector<uint8_t> state;
+    std::vector<uint16_t> dtz;
+    std::vector<uint8_t> counter;      // Moves not yet known to lose, for the undecided positions
+  };
+
+  bool build(const CTablebase::Material &material);
+
+  // Runs the function over [0, count) split into chunks across the pool
+  void parallelFor(uint64_t count, const std::function<void(uint64_t, uint64_t)> &function);
+
+  void initEntry(Tables &tables, uint64_t entry);
+
+  // Hands the result of an entry decided dtz - 1 plies from the end to its predecessors, returns how many it decided
+  uint64_t propagate(Tables &tables, uint64_t entry, uint16_t dtz);
+
+  bool write(const Tables &tables) const;
+
+  std::string m_directory;
+  CThreadPool m_pool;
+};
+
+
+#endif //SFML_CHESS_CTABLEBASEGENERATOR_H
@@ -0,0 +1,120 @@
+//
+// Created by Petr Smerda on 09.09.2024.
+//
+
+#include "CThreadPool.h"
+
+
+// Pool and worker index of the current thread, so tasks submitted from a task go to the local deque
+static thread_local CThreadPool *currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+
+CThreadPool::CThreadPool(int threads) {
+  if (threads < 1)
+    threads = 1;
+
+  for (int i = 0; i < threads; ++i)
+    m_workers.push_back(std::make_unique<Worker>());
+
+  for (int i = 0; i < threads; ++i)
+    m_threads.emplace_back(&CThreadPool::run, this, i);
+}
+
+
+CThreadPool::~CThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+
+  m_workAvailable.notify_all();
+
+  for (auto &thread: m_threads)
+    thread.join();
+}
+
+
+void CThreadPool::submit(std::function<void()> task) {
+  int index = currentPool == this ? currentWorker : static_cast<int>(m_nextWorker++ % m_workers.size());
+
+  m_pending++;
+
+  {
+    std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+    m_workers[index]->tasks.push_back(std::move(task));
+  }
+
+  {
+    // Taking the lock makes sure a worker going to sleep sees the new task
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queued++;
+  }
+
+  m_workAvailable.notify_one();
+}
+
+
+void CThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_allDone.wait(lock, [this] { return m_pending == 0; });
+}
+
+
+bool CThreadPool::popTask(int index, std::function<void()> &task) {
+  // Own deque from the back (depth first, hot in cache)
+  {
+    Worker &own = *m_workers[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      m_queued--;
+      return true;
+    }
+  }
+
+  // Steal from the front of the others (the oldest tasks are usually the biggest)
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    Worker &victim = *m_workers[(index + i) % m_workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      m_queued--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+void CThreadPool::run(int index) {
+  currentPool = this;
+  currentWorker = index;
+
+  std::function<void()> task;
+
+  while (true) {
+    if (popTask(index, task)) {
+      task();
+      task = nullptr;
+
+      if (--m_pending == 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allDone.notify_all();
+      }
+
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workAvailable.wait(lock, [this] { return m_stop || m_queued > 0; });
+
+    if (m_stop && m_queued == 0)
+      return;
+  }
+}
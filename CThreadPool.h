@@ -0,0 +1,61 @@
+//
+// Created by Petr Smerda on 09.09.2024.
+//
+
+#ifndef SFML_CHESS_CTHREADPOOL_H
+#define SFML_CHESS_CTHREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing pool: every worker owns a deque, runs its newest task first and steals the oldest task of another
+// worker when its own deque is empty. Tasks may submit further tasks, which go to the deque of the running worker.
+class CThreadPool {
+public:
+  explicit CThreadPool(int threads);
+
+  ~CThreadPool();
+
+  CThreadPool(const CThreadPool &) = delete;
+
+  CThreadPool &operator=(const CThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+
+  // Blocks until every submitted task, including the ones submitted by tasks, has finished
+  void wait();
+
+  int size() const { return static_cast<int>(m_threads.size()); }
+
+private:
+  struct alignas(64) Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void run(int index);
+
+  bool popTask(int index, std::function<void()> &task);
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::vector<std::thread> m_threads;
+
+  std::atomic<int> m_queued{0};   // Tasks waiting in the deques
+  std::atomic<int> m_pending{0};  // Tasks not finished yet
+  std::atomic<unsigned> m_nextWorker{0};
+  bool m_stop = false;
+
+  std::mutex m_mutex;
+  std::condition_variable m_workAvailable;
+  std::condition_variable m_allDone;
+};
+
+
+#endif //SFML_CHESS_CTHREADPOOL_H
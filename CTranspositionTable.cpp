@@ -0,0 +1,117 @@
+//
+// Created by Petr Smerda on 12.09.2024.
+//
+
+#include "CTranspositionTable.h"
+
+
+CTranspositionTable::CTranspositionTable(size_t megabytes) {
+  resize(megabytes);
+}
+
+
+void CTranspositionTable::resize(size_t megabytes) {
+  m_clusterCount = megabytes * 1024 * 1024 / sizeof(Cluster);
+  if (m_clusterCount == 0)
+    m_clusterCount = 1;
+
+  m_clusters = std::make_unique<Cluster[]>(m_clusterCount);
+  m_generation = 0;
+}
+
+
+void CTranspositionTable::clear() {
+  for (size_t i = 0; i < m_clusterCount; ++i)
+    for (Entry &entry: m_clusters[i].entries) {
+      entry.check.store(0, std::memory_order_relaxed);
+      entry.data.store(0, std::memory_order_relaxed);
+    }
+
+  m_generation = 0;
+}
+
+
+void CTranspositionTable::newSearch() {
+  m_generation = (m_generation + 1) & ((1 << GENERATION_BITS) - 1);
+}
+
+
+bool CTranspositionTable::probe(uint64_t key, Data &data) const {
+  for (const Entry &entry: cluster(key).entries) {
+    uint64_t raw = entry.data.load(std::memory_order_relaxed);
+
+    if ((entry.check.load(std::memory_order_relaxed) ^ raw) != key || !raw)
+      continue;
+
+    data.move = CMove::fromRaw(static_cast<uint16_t>(raw));
+    data.score = static_cast<int16_t>((raw >> 16) & 0xFFFF);
+    data.depth = static_cast<int8_t>((raw >> 32) & 0xFF);
+    data.bound = static_cast<Bound>((raw >> 40) & 0x3);
+    return true;
+  }
+
+  return false;
+}
+
+
+void CTranspositionTable::store(uint64_t key, CMove move, int score, int depth, Bound bound) {
+  Cluster &c = cluster(key);
+  Entry *replace = nullptr;
+  int worstValue = 0;
+
+  for (Entry &entry: c.entries) {
+    uint64_t raw = entry.data.load(std::memory_order_relaxed);
+
+    if (!raw) {
+      replace = &entry;
+      break;
+    }
+
+    int age = (m_generation - static_cast<int>(raw >> 42)) & ((1 << GENERATION_BITS) - 1);
+    int oldDepth = static_cast<int8_t>((raw >> 32) & 0xFF);
+
+    // The same position keeps a much deeper result of this search, e.g. against a quiescence store, unless the new
+    // one is exact. The old move stays if we have none.
+    if ((entry.check.load(std::memory_order_relaxed) ^ raw) == key) {
+      if (bound != BOUND_EXACT && !age && depth + REPLACE_DEPTH_MARGIN < oldDepth)
+        return;
+
+      if (!move)
+        move = CMove::fromRaw(static_cast<uint16_t>(raw));
+
+      replace = &entry;
+      break;
+    }
+
+    // Otherwise replace the shallowest entry, every search of age counting as 8 plies of depth
+    int value = oldDepth - 8 * age;
+
+    if (!replace || value < worstValue) {
+      replace = &entry;
+      worstValue = value;
+    }
+  }
+
+  uint64_t data = static_cast<uint64_t>(move.raw()) |
+                  static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16 |
+                  static_cast<uint64_t>(static_cast<uint8_t>(depth)) << 32 |
+                  static_cast<uint64_t>(bound) << 40 |
+                  static_cast<uint64_t>(m_generation) << 42;
+
+  replace->check.store(key ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
+
+
+int CTranspositionTable::hashfull() const {
+  size_t samples = m_clusterCount < 250 ? m_clusterCount : 250;
+  int used = 0;
+
+  for (size_t i = 0; i < samples; ++i)
+    for (const Entry &entry: m_clusters[i].entries) {
+      uint64_t raw = entry.data.load(std::memory_order_relaxed);
+      used += raw && static_cast<uint8_t>(raw >> 42) == m_generation;
+    }
+
+  return static_cast<int>(used * 1000 / (samples * CLUSTER_SIZE));
+}
@@ -0,0 +1,78 @@
+//
+// Created by Petr Smerda on 12.09.2024.
+//
+
+#ifndef SFML_CHESS_CTRANSPOSITIONTABLE_H
+#define SFML_CHESS_CTRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "CMove.h"
+
+
+// Hash table of search results shared by all search threads without locks. Every entry is written as two words,
+// (key ^ data, data): a torn write of two threads no longer matches its key and reads as a miss.
+class CTranspositionTable {
+public:
+  enum Bound {
+    BOUND_NONE = 0,
+    BOUND_UPPER = 1,  // Score is at most the stored one (fail low)
+    BOUND_LOWER = 2,  // Score is at least the stored one (fail high)
+    BOUND_EXACT = 3,
+  };
+
+  // Decoded content of an entry
+  struct Data {
+    CMove move;
+    int score;
+    int depth;
+    Bound bound;
+  };
+
+  explicit CTranspositionTable(size_t megabytes = 16);
+
+  void resize(size_t megabytes);
+
+  void clear();
+
+  // Called before every search, older entries are replaced first
+  void newSearch();
+
+  bool probe(uint64_t key, Data &data) const;
+
+  void store(uint64_t key, CMove move, int score, int depth, Bound bound);
+
+  // Permille of the table used by the current search
+  int hashfull() const;
+
+private:
+  static constexpr int CLUSTER_SIZE = 4;
+  static constexpr int GENERATION_BITS = 6;
+  static constexpr int REPLACE_DEPTH_MARGIN = 3;  // A result of the same position this much shallower still replaces
+
+  struct Entry {
+    std::atomic<uint64_t> check{0};  // key ^ data
+    std::atomic<uint64_t> data{0};   // move:16 | score:16 | depth:8 | bound:2 | generation:6
+  };
+
+  // One cache line
+  struct alignas(64) Cluster {
+    Entry entries[CLUSTER_SIZE];
+  };
+
+  static_assert(sizeof(Cluster) == 64, "cluster must fill exactly one cache line");
+
+  Cluster &cluster(uint64_t key) const {
+    // Multiply-shift maps the key uniformly onto any table size
+    return m_clusters[static_cast<size_t>((static_cast<__uint128_t>(key) * m_clusterCount) >> 64)];
+  }
+
+  std::unique_ptr<Cluster[]> m_clusters;
+  size_t m_clusterCount = 0;
+  uint8_t m_generation = 0;
+};
+
+
+#endif //SFML_CHESS_CTRANSPOSITIONTABLE_H
@@ -0,0 +1,46 @@
+//
+// Created by Petr Smerda on 09.09.2024.
+//
+
+#include "CZobrist.h"
+
+
+uint64_t CZobrist::m_pieces[12][64];
+uint64_t CZobrist::m_castling[16];
+uint64_t CZobrist::m_enPassant[8];
+uint64_t CZobrist::m_side;
+
+
+void CZobrist::init() {
+  static const bool initialized = [] {
+    // Fixed seed, so the keys (and everything stored with them) are the same on every run
+    uint64_t seed = 1070372ULL;
+    auto random = [&seed]() {
+      seed ^= seed >> 12;
+      seed ^= seed << 25;
+      seed ^= seed >> 27;
+      return seed * 2685821657736338717ULL;
+    };
+
+    for (auto &piece: m_pieces)
+      for (auto &key: piece)
+        key = random();
+
+    // Every single right has its own key, combinations are their XOR
+    uint64_t rights[4] = {random(), random(), random(), random()};
+    for (int i = 0; i < 16; ++i) {
+      m_castling[i] = 0;
+      for (int right = 0; right < 4; ++right)
+        if (i & (1 << right))
+          m_castling[i] ^= rights[right];
+    }
+
+    for (auto &key: m_enPassant)
+      key = random();
+
+    m_side = random();
+    return true;
+  }();
+
+  (void) initialized;
+}
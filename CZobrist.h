@@ -0,0 +1,34 @@
+//
+// Created by Petr Smerda on 09.09.2024.
+//
+
+#ifndef SFML_CHESS_CZOBRIST_H
+#define SFML_CHESS_CZOBRIST_H
+
+#include <cstdint>
+
+
+// Random keys for Zobrist hashing of positions. Pieces are indexed as in FEN order: P N B R Q K p n b r q k
+class CZobrist {
+private:
+  static uint64_t m_pieces[12][64];
+  static uint64_t m_castling[16];
+  static uint64_t m_enPassant[8];
+  static uint64_t m_side;
+
+public:
+  static void init();
+
+  inline static uint64_t piece(int piece, int square) { return m_pieces[piece][square]; }
+
+  // Castling rights as 4 bits: white king side, white queen side, black king side, black queen side
+  inline static uint64_t castling(int rights) { return m_castling[rights]; }
+
+  inline static uint64_t enPassant(int file) { return m_enPassant[file]; }
+
+  // Included when black is on move
+  inline static uint64_t side() { return m_side; }
+};
+
+
+#endif //SFML_CHESS_CZOBRIST_H
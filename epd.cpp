@@ -0,0 +1,410 @@
+//
+// Created by Petr Smerda on 11.10.2024.
+//
+
+#include "CBoard.h"
+#include "CSearchPool.h"
+#include "CThreadPool.h"
+#include "CTranspositionTable.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+
+// One line of an EPD file (https://www.chessprogramming.org/Extended_Position_Description), only the operations used
+// for test suites are kept
+struct EpdEntry {
+  std::string fen;
+  std::string id;
+  std::vector<std::string> bestMoves;   // bm, any of them solves the position
+  std::vector<std::string> avoidMoves;  // am, solved by any other move
+};
+
+struct EpdOptions {
+  int threads = 1;        // Positions searched at once, each with a single search thread
+  SearchLimits limits;
+  size_t hashMegabytes = 16;
+  int minSolved = 0;      // Fewer solved positions fail the run
+  bool verbose = true;
+};
+
+// Search of one position, with the time the answer was first found and kept until the end
+struct EpdResult {
+  bool scored = false;
+  bool solved = false;
+  int64_t solvedMs = -1;
+  uint64_t nodes = 0;
+  std::string found;
+};
+
+
+static bool isNumber(const std::string &text) {
+  return !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+
+// Opcode and operands of every operation up to its ';', quoted operands may contain spaces and semicolons. The clocks
+// of a full FEN may come before the operations.
+static bool parseEpd(const std::string &line, int lineNumber, EpdEntry &entry) {
+  std::istringstream stream(line);
+  std::string placement, side, castling, enPassant;
+
+  if (!(stream >> placement >> side >> castling >> enPassant))
+    return false;
+
+  entry.id = std::to_string(lineNumber);
+  entry.bestMoves.clear();
+  entry.avoidMoves.clear();
+
+  std::string halfmoves = "0", fullmoves = "1";
+  std::string opcode;
+
+  std::streampos operations = stream.tellg();
+  std::string first, second;
+  if (stream >> first >> second && isNumber(first) && isNumber(second)) {
+    halfmoves = first;
+    fullmoves = second;
+  } else {
+    stream.clear();
+    stream.seekg(operations);
+  }
+
+  while (stream >> opcode) {
+    std::vector<std::string> operands;
+    bool end = false;
+
+    while (!end) {
+      stream >> std::ws;
+      if (stream.peek() == '"') {
+        stream.get();
+        std::string operand;
+        std::getline(stream, operand, '"');
+        operands.push_back(operand);
+        stream >> std::ws;
+        if (stream.peek() == ';')
+          stream.get(), end = true;
+      } else {
+        std::string operand;
+        if (!(stream >> operand))
+          break;
+
+        end = operand.back() == ';';
+        if (end)
+          operand.pop_back();
+        if (!operand.empty())
+          operands.push_back(operand);
+      }
+
+      end = end || !stream;
+    }
+
+    if (opcode == "bm")
+      entry.bestMoves = operands;
+    else if (opcode == "am")
+      entry.avoidMoves = operands;
+    else if (opcode == "id" && !operands.empty())
+      entry.id = operands[0];
+    else if (opcode == "hmvc" && !operands.empty())
+      halfmoves = operands[0];
+    else if (opcode == "fmvn" && !operands.empty())
+      fullmoves = operands[0];
+  }
+
+  entry.fen = placement + " " + side + " " + castling + " " + enPassant + " " + halfmoves + " " + fullmoves;
+
+  if (entry.bestMoves.empty() && entry.avoidMoves.empty())
+    fprintf(stderr, "line %d: no bm or am operation, the position is not scored\n", lineNumber);
+
+  return true;
+}
+
+
+// Standard algebraic notation without the check sign, which test suites do not write consistently
+static std::string toSan(const CBoard &board, const CMoveList &moves, CMove move) {
+  if (move.isCastling())
+    return move.flags() == CMove::KING_CASTLE ? "O-O" : "O-O-O";
+
+  char piece = board.pieceAt(move.from());
+  std::string san;
+
+  if (piece == 'P') {
+    if (move.isCapture())
+      san += static_cast<char>('a' + move.from() % 8);
+  } else {
+    san += piece;
+
+    // Another piece of the same kind reaching the square: file if that tells them apart, rank if not, else both
+    bool ambiguous = false, sameFile = false, sameRank = false;
+    for (CMove other: moves) {
+      if (other.to() != move.to() || other.from() == move.from() || board.pieceAt(other.from()) != piece)
+        continue;
+
+      ambiguous = true;
+      sameFile = sameFile || other.from() % 8 == move.from() % 8;
+      sameRank = sameRank || other.from() / 8 == move.from() / 8;
+    }
+
+    if (ambiguous && (!sameFile || sameRank))
+      san += static_cast<char>('a' + move.from() % 8);
+    if (ambiguous && sameFile)
+      san += static_cast<char>('1' + move.from() / 8);
+  }
+
+  if (move.isCapture())
+    san += 'x';
+
+  san += {static_cast<char>('a' + move.to() % 8), static_cast<char>('1' + move.to() / 8)};
+
+  if (move.isPromotion())
+    san += std::string("=") + move.promotionPiece();
+
+  return san;
+}
+
+
+// Drops what writers of SAN differ in: check and annotation signs, 'x' of captures (missing in a few WAC
+// positions), '=' of promotions, castling with zeros
+static std::string normalizeSan(const std::string &san) {
+  std::string res;
+
+  for (char c: san) {
+    if (c == '+' || c == '#' || c == '!' || c == '?' || c == '=' || c == 'x')
+      continue;
+    res += c == '0' ? 'O' : c;
+  }
+
+  return res;
+}
+
+
+// A move matches in SAN or in coordinate notation
+static bool matchesAny(const CBoard &board, const CMoveList &moves, CMove move, const std::vector<std::string> &list) {
+  std::string san = normalizeSan(toSan(board, moves, move));
+
+  for (const std::string &text: list)
+    if (normalizeSan(text) == san || text == move.toString())
+      return true;
+
+  return false;
+}
+
+
+static bool isSolution(const CBoard &board, const CMoveList &moves, const EpdEntry &entry, CMove move) {
+  if (!move)
+    return false;
+  if (!entry.bestMoves.empty() && !matchesAny(board, moves, move, entry.bestMoves))
+    return false;
+
+  return !matchesAny(board, moves, move, entry.avoidMoves);
+}
+
+
+/**********************************************************************************************************************
+ *                                                      Runner                                                        *
+ **********************************************************************************************************************/
+
+// Search with its own hash table, used by one position at a time
+struct EpdSearcher {
+  CTranspositionTable tt;
+  CSearchPool pool;
+
+  explicit EpdSearcher(size_t hashMegabytes) : tt(hashMegabytes), pool(tt, 1) {}
+};
+
+
+static EpdResult solve(EpdSearcher &searcher, const EpdEntry &entry, const SearchLimits &limits) {
+  EpdResult result;
+  CBoard board;
+
+  if (!board.loadFen(entry.fen))
+    return result;
+
+  CMoveList moves;
+  board.generateMoves(moves);
+  result.scored = !entry.bestMoves.empty() || !entry.avoidMoves.empty();
+
+  // Every position starts from an empty table, so the result does not depend on which position came before
+  searcher.tt.clear();
+  searcher.pool.setInfoCallback([&](const SearchResult &info) {
+    if (!isSolution(board, moves, entry, info.bestMove))
+      result.solvedMs = -1;
+    else if (result.solvedMs < 0)
+      result.solvedMs = info.timeMs;
+  });
+
+  SearchResult searched = searcher.pool.search(board, limits);
+
+  result.nodes = searched.nodes;
+  result.found = searched.bestMove ? toSan(board, moves, searched.bestMove) : "-";
+  result.solved = result.scored && isSolution(board, moves, entry, searched.bestMove);
+  if (!result.solved)
+    result.solvedMs = -1;
+  else if (result.solvedMs < 0)
+    result.solvedMs = searched.timeMs;
+
+  return result;
+}
+
+
+static int runEpd(std::istream &input, const EpdOptions &options) {
+  // One searcher per thread of the pool, a task takes whichever is free
+  std::vector<std::unique_ptr<EpdSearcher>> searchers;
+  std::vector<EpdSearcher *> freeSearchers;
+  for (int i = 0; i < options.threads; ++i) {
+    searchers.push_back(std::make_unique<EpdSearcher>(options.hashMegabytes));
+    freeSearchers.push_back(searchers.back().get());
+  }
+
+  std::mutex mutex;
+  std::condition_variable taskDone;
+  int queued = 0;  // Positions handed to the pool and not finished yet
+  int positions = 0, scored = 0, solved = 0;
+  int64_t solvedMs = 0;
+  uint64_t nodes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  CThreadPool threadPool(options.threads);
+  std::string line;
+  int lineNumber = 0;
+
+  // Lines are read only as the pool needs them, at most two positions per thread wait, so a large file is never held
+  // in memory as a whole
+  while (std::getline(input, line)) {
+    lineNumber++;
+
+    auto entry = std::make_shared<EpdEntry>();
+    if (line.empty() || line[0] == '#' || !parseEpd(line, lineNumber, *entry))
+      continue;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      taskDone.wait(lock, [&] { return queued < 2 * options.threads; });
+      queued++;
+    }
+
+    threadPool.submit([&, entry] {
+      EpdSearcher *searcher;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        searcher = freeSearchers.back();
+        freeSearchers.pop_back();
+      }
+
+      EpdResult result = solve(*searcher, *entry, options.limits);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      freeSearchers.push_back(searcher);
+      queued--;
+      taskDone.notify_one();
+
+      positions++;
+      nodes += result.nodes;
+      scored += result.scored;
+
+      if (result.solved) {
+        solved++;
+        solvedMs += result.solvedMs;
+      }
+
+      if (options.verbose) {
+        std::string expected;
+        for (const std::string &move: entry->bestMoves)
+          expected += " " + move;
+        for (const std::string &move: entry->avoidMoves)
+          expected += " !" + move;
+
+        if (!result.scored)
+          printf("%-16s %-8s %-8s\n", entry->id.c_str(), "", result.found.c_str());
+        else if (result.solved)
+          printf("%-16s %-8s %-8s %6lld ms  expected%s\n", entry->id.c_str(), "OK", result.found.c_str(),
+                 static_cast<long long>(result.solvedMs), expected.c_str());
+        else
+          printf("%-16s %-8s %-8s %6s     expected%s\n", entry->id.c_str(), "FAIL", result.found.c_str(), "",
+                 expected.c_str());
+        fflush(stdout);
+      }
+    });
+  }
+
+  threadPool.wait();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("\npositions %d  solved %d / %d", positions, solved, scored);
+  if (scored)
+    printf(" (%.1f %%)", 100.0 * solved / scored);
+  printf("  time to solution %.3f s total, %.0f ms average\n", solvedMs / 1000.0,
+         solved ? static_cast<double>(solvedMs) / solved : 0.0);
+  printf("nodes %llu  time %.3f s  %.2f Mnps on %d threads\n", static_cast<unsigned long long>(nodes), seconds,
+         seconds > 0 ? static_cast<double>(nodes) / seconds / 1e6 : 0.0, options.threads);
+
+  return solved >= options.minSolved ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[]) {
+  EpdOptions options;
+  std::vector<char *> args;
+
+  // Options may be given anywhere, the rest are positional arguments
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if ((arg == "-t" || arg == "-m" || arg == "-n" || arg == "-d" || arg == "-H" || arg == "-s") && i + 1 < argc) {
+      long long value = std::atoll(argv[++i]);
+      if (arg == "-t")
+        options.threads = value > 0 ? static_cast<int>(value) : static_cast<int>(std::thread::hardware_concurrency());
+      else if (arg == "-m")
+        options.limits.timeMs = std::max(1LL, value);
+      else if (arg == "-n")
+        options.limits.nodes = static_cast<uint64_t>(std::max(1LL, value));
+      else if (arg == "-d")
+        options.limits.depth = static_cast<int>(std::clamp(value, 1LL, static_cast<long long>(CSearch::MAX_PLY - 1)));
+      else if (arg == "-H")
+        options.hashMegabytes = static_cast<size_t>(std::max(1LL, value));
+      else
+        options.minSolved = static_cast<int>(value);
+    } else if (arg == "-q")
+      options.verbose = false;
+    else
+      args.push_back(argv[i]);
+  }
+
+  std::string command = args.empty() ? "" : args[0];
+
+  if (args.size() != 1 || command == "-h" || command == "--help") {
+    printf("usage: chess_epd [options] <file>    solve the bm / am positions of an EPD test suite, - reads stdin\n"
+           "\n"
+           "options: -t <threads>   positions searched at once, one thread each (0 = all cores)\n"
+           "         -m <ms>        time per position (1000 when no other limit is given)\n"
+           "         -n <nodes>     nodes per position\n"
+           "         -d <depth>     depth per position\n"
+           "         -H <MB>        hash table of every thread (16)\n"
+           "         -s <count>     exit with 1 when fewer positions are solved\n"
+           "         -q             only the summary\n");
+    return args.size() == 1 ? 0 : 1;
+  }
+
+  SearchLimits &limits = options.limits;
+  if (!limits.timeMs && !limits.nodes && !limits.depth)
+    limits.timeMs = 1000;
+
+  if (command == "-")
+    return runEpd(std::cin, options);
+
+  std::ifstream file(command);
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", command.c_str());
+    return 1;
+  }
+
+  return runEpd(file, options);
+}
@@ -1,10 +1,69 @@
 // Link to fonts            "/System/Library/Fonts/Supplemental/Arial.ttf"
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
 #include "CBoard.h"
+#include "CBoardRenderer.h"
+#include "CNnue.h"
+#include "CSearchThread.h"
+#include "CTablebase.h"
+
+
+// What the background search is working on
+enum class EngineJob {
+  NONE,
+  MOVE,      // The engine's own move
+  PONDER,    // The position after the reply the engine expects, on the player's time
+  ANALYSIS,  // The position on the board, until something changes
+};
+
+
+// Score in pawns or moves to mate: +0.35, -M3
+static std::string scoreText(int score) {
+  char text[16];
+
+  if (CSearch::isMateScore(score))
+    snprintf(text, sizeof(text), "%sM%d", score > 0 ? "+" : "-", (CSearch::MATE_VALUE - std::abs(score) + 1) / 2);
+  else if (CSearch::isDecisiveScore(score))
+    snprintf(text, sizeof(text), "%sTB", score > 0 ? "+" : "-");
+  else
+    snprintf(text, sizeof(text), "%+.2f", score / 100.0);
+
+  return text;
+}
+
+
+int main(int argc, char *argv[]) {
+  // One core stays with the window, the search gets the others
+  int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  int64_t moveTimeMs = 3000;
+  size_t hashMegabytes = 64;
+
+  for (int i = 1; i + 1 < argc; ++i) {
+    std::string arg = argv[i];
+
+    // Network evaluation with --nnue <file>, the handcrafted evaluation stays if it cannot be loaded
+    if (arg == "--nnue" && CNnue::load(argv[i + 1]))
+      std::cout << "NNUE " << argv[i + 1] << " loaded, " << CNnue::simdName() << " kernels" << std::endl;
+
+    // Endgame tablebases made by chess_tbgen with --tb <directory>
+    if (arg == "--tb")
+      std::cout << CTablebase::init(argv[i + 1]) << " tablebases loaded from " << argv[i + 1] << std::endl;
+
+    if (arg == "--threads")
+      threads = std::max(1, std::atoi(argv[i + 1]));
+    if (arg == "--movetime")
+      moveTimeMs = std::max(100, std::atoi(argv[i + 1]));
+    if (arg == "--hash")
+      hashMegabytes = std::max(1, std::atoi(argv[i + 1]));
+  }
 
 
-int main() {
-  sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "CHESS negamax", sf::Style::Close);
+  sf::RenderWindow window(sf::VideoMode(WIDTH + EVAL_BAR_WIDTH, HEIGHT), "CHESS negamax", sf::Style::Close);
 
   window.setFramerateLimit(60);
 
@@ -12,6 +71,7 @@ int main() {
 
   // Initialize the board
   CBoard brd;
+  CBoardRenderer renderer;
 
   std::string textures[] = {
           "../assets/white-pawn.png",
@@ -29,12 +89,68 @@ int main() {
   };
 
   // Load textures of the pieces
-  if (!brd.loadTextures(textures))
+  if (!renderer.loadTextures(textures))
     return -1;
 
 
   Bitboard moveFrom = 0;
 
+  // The search never runs on this thread, the window only polls it once per frame
+  CSearchThread engine(hashMegabytes, threads);
+  EngineJob job = EngineJob::NONE;
+
+  int engineSide = 0;          // 1 or -1 while the engine plays white or black, switched with E
+  bool analysis = false;       // A
+  bool ponder = false;         // P
+  CMove ponderMove = CMove();  // Reply the engine expects to its last move
+  uint64_t ponderKey = 0;      // Position after that reply
+
+  SearchResult shown;          // Latest iteration on the screen
+  bool shownWhite = true;      // Side to move in the position it belongs to
+  std::string title;
+
+  auto engineToMove = [&]() { return engineSide == (brd.whiteToMove() ? 1 : -1); };
+
+  // Called whenever the board or the modes change: stops what no longer fits and starts what the modes ask for
+  auto updateEngine = [&]() {
+    if (job == EngineJob::PONDER && engine.running() && engineToMove() && brd.key() == ponderKey) {
+      // The player made the expected reply, the search goes on with the clock running
+      engine.ponderhit();
+      job = EngineJob::MOVE;
+      return;
+    }
+
+    engine.stop();
+    job = EngineJob::NONE;
+    shown.bestMove = CMove();
+    shown.pv.clear();
+
+    CMoveList moves;
+    brd.generateMoves(moves);
+    if (moves.empty())
+      return;
+
+    SearchLimits limits;
+    CBoard searched = brd;
+
+    if (engineToMove()) {
+      limits.timeMs = moveTimeMs;
+      job = EngineJob::MOVE;
+    } else if (engineSide && ponder && ponderMove && brd.isMoveLegal(ponderMove)) {
+      searched.makeMove(ponderMove);
+      ponderKey = searched.key();
+      limits.timeMs = moveTimeMs;
+      limits.ponder = true;
+      job = EngineJob::PONDER;
+    } else if (analysis)
+      job = EngineJob::ANALYSIS;
+    else
+      return;
+
+    shownWhite = searched.whiteToMove();
+    engine.start(searched, limits);
+  };
+
 
   // Main loop handling window
 
@@ -50,12 +166,50 @@ int main() {
           window.close();
           break;
 
+        case sf::Event::KeyPressed:
+          switch (event.key.code) {
+            case sf::Keyboard::E:
+              // The engine takes the side to move, or gives it back
+              engineSide = engineSide ? 0 : (brd.whiteToMove() ? 1 : -1);
+              ponderMove = CMove();
+              updateEngine();
+              break;
+
+            case sf::Keyboard::A:
+              analysis = !analysis;
+              updateEngine();
+              break;
+
+            case sf::Keyboard::P:
+              ponder = !ponder;
+              updateEngine();
+              break;
+
+            case sf::Keyboard::Space:
+              // Move now, the best move found so far is played
+              if (job == EngineJob::MOVE)
+                engine.stop();
+              break;
+
+            default:
+              break;
+          }
+          break;
+
         case sf::Event::MouseButtonPressed:
-          if (event.mouseButton.button == sf::Mouse::Right)
+          if (event.mouseButton.button == sf::Mouse::Right) {
+            // Against the engine a whole move is taken back, so it is the player's turn again
             brd.unmakeMove();
+            if (engineSide && engineToMove())
+              brd.unmakeMove();
 
+            moveFrom = 0;
+            ponderMove = CMove();
+            updateEngine();
+          }
 
-          if (event.mouseButton.button == sf::Mouse::Left) {
+
+          if (event.mouseButton.button == sf::Mouse::Left && mouseX < WIDTH && !engineToMove()) {
             // Here we need to get the index of the piece we clicked
             int index = (mouseX / TILE) + ((HEIGHT - mouseY) / TILE) * 8;
             Bitboard currentPos = 1ULL << index;
@@ -74,8 +228,13 @@ int main() {
 
 
               // If the move is in legal moves, provide it, if not just continue
-              if (brd.isMoveLegal(moveFrom, moveTo))
-                brd.makeMove(moveFrom, moveTo);
+              CMove move = brd.findMove(moveFrom, moveTo);
+
+              if (move.isPromotion())
+                move = brd.findMove(moveFrom, moveTo, CBoardRenderer::showPromotionWindow());
+
+              if (brd.makeMove(move))
+                updateEngine();
 
 
               moveFrom = 0;
@@ -89,15 +248,54 @@ int main() {
     }
 
 
-    if (brd.isPromotion())
-      brd.handlePromotion(CBoard::showPromotionWindow());
+    // Results of searches stopped on purpose are dropped, only the engine's own move is played
+    SearchResult result;
+    if (engine.poll(result)) {
+      if (job == EngineJob::MOVE && engineToMove() && brd.makeMove(result.bestMove)) {
+        ponderMove = result.pv.size() > 1 ? result.pv[1] : CMove();
+        job = EngineJob::NONE;
+        updateEngine();
+      } else
+        job = EngineJob::NONE;
+    }
+
+    if (job != EngineJob::NONE) {
+      SearchResult info = engine.progress();
+      if (info.depth > 0)
+        shown = info;
+    }
+
+    // Search info in the title, no font needed
+    std::string newTitle = "CHESS negamax";
+    if (shown.depth > 0) {
+      char text[64];
+      snprintf(text, sizeof(text), "  depth %d  %s  %.2f Mnps ", shown.depth,
+               scoreText(shownWhite ? shown.score : -shown.score).c_str(),
+               shown.timeMs > 0 ? static_cast<double>(shown.nodes) / static_cast<double>(shown.timeMs) / 1000.0 : 0.0);
+      newTitle += text;
+
+      for (size_t i = 0; i < shown.pv.size() && i < 8; ++i)
+        newTitle += " " + shown.pv[i].toString();
+    }
+
+    if (newTitle != title) {
+      title = newTitle;
+      window.setTitle(title);
+    }
+
 
     window.clear(sf::Color::Black);
 
-    brd.draw(window, moveFrom);
+    renderer.draw(window, brd, moveFrom);
+
+    // The pondered position is not on the board, so its move is not shown
+    if (job == EngineJob::MOVE || job == EngineJob::ANALYSIS)
+      renderer.drawArrow(window, shown.bestMove);
+
+    renderer.drawEvalBar(window, shownWhite ? shown.score : -shown.score, CSearch::isMateScore(shown.score));
 
     window.display();
   }
 
   return 0;
-}
\ No newline at end of file
+}
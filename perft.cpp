@@ -0,0 +1,318 @@
+//
+// Created by Petr Smerda on 07.09.2024.
+//
+
+#include "CBoard.h"
+#include "CThreadPool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+
+static const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Standard positions with known node counts (https://www.chessprogramming.org/Perft_Results)
+struct PerftPosition {
+  const char *name;
+  const char *fen;
+  int depth;
+  uint64_t nodes;
+};
+
+static const PerftPosition perftSuite[] = {
+        {"startpos",  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",                                6, 119060324},
+        {"kiwipete",  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",                    5, 193690690},
+        {"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",                                               7, 178633661},
+        {"position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",                        5, 15833292},
+        {"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",                               5, 89941194},
+        {"position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",                5, 164075551},
+};
+
+
+// Subtree counts shared by all threads. Lock-free: an entry is stored as (key ^ data, data), so a torn write made by
+// two threads at once no longer matches its key and is ignored.
+class CPerftTable {
+public:
+  explicit CPerftTable(size_t megabytes) {
+    size_t count = 2;
+    while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+      count *= 2;
+
+    m_entries = std::make_unique<Entry[]>(count);
+    m_mask = count - 1;
+  }
+
+  bool probe(uint64_t key, int depth, uint64_t &nodes) const {
+    // Bucket of two: depth-preferred slot and always-replace slot
+    for (size_t i = 0; i < 2; ++i) {
+      const Entry &entry = m_entries[(key & m_mask & ~1ULL) + i];
+      uint64_t data = entry.data.load(std::memory_order_relaxed);
+
+      if ((entry.check.load(std::memory_order_relaxed) ^ data) == key && static_cast<int>(data & 0xFF) == depth) {
+        nodes = data >> 8;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void store(uint64_t key, int depth, uint64_t nodes) {
+    Entry *bucket = &m_entries[key & m_mask & ~1ULL];
+    Entry &entry = depth >= static_cast<int>(bucket[0].data.load(std::memory_order_relaxed) & 0xFF) ? bucket[0] : bucket[1];
+    uint64_t data = nodes << 8 | static_cast<uint64_t>(depth);
+
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    std::atomic<uint64_t> check{0};
+    std::atomic<uint64_t> data{0};  // Node count << 8 | depth
+  };
+
+  std::unique_ptr<Entry[]> m_entries;
+  size_t m_mask;
+};
+
+
+// Leaf nodes at the given depth, the last layer is counted in bulk from the size of the move list
+static uint64_t perft(CBoard &board, int depth, CPerftTable *table = nullptr) {
+  if (depth == 0)
+    return 1;
+
+  CMoveList moves;
+  board.generateMoves(moves);
+
+  if (depth == 1)
+    return moves.size();
+
+  uint64_t key = 0, nodes = 0;
+  if (table) {
+    key = board.key();
+    if (table->probe(key, depth, nodes))
+      return nodes;
+  }
+
+  for (CMove move: moves) {
+    board.makeMove(move);
+    nodes += perft(board, depth - 1, table);
+    board.unmakeMove();
+  }
+
+  if (table)
+    table->store(key, depth, nodes);
+
+  return nodes;
+}
+
+
+struct PerftOptions {
+  int threads = 1;
+  CPerftTable *table = nullptr;  // Shared by all runs, a subtree count stays valid for the whole process
+};
+
+
+// Runs the subtree as a pool task on its own copy of the board; the first plies are split into further tasks
+static void submitPerft(CThreadPool &pool, CPerftTable *table, const CBoard &board, int depth, int splitPlies,
+                        std::atomic<uint64_t> &counter) {
+  pool.submit([&pool, table, clone = board, depth, splitPlies, &counter]() mutable {
+    if (splitPlies == 0 || depth <= 3) {
+      counter += perft(clone, depth, table);
+      return;
+    }
+
+    CMoveList moves;
+    clone.generateMoves(moves);
+
+    for (CMove move: moves) {
+      CBoard child = clone;
+      child.makeMove(move);
+      submitPerft(pool, table, child, depth - 1, splitPlies - 1, counter);
+    }
+  });
+}
+
+
+// Node counts below every root move, computed in parallel when more threads are requested
+static std::vector<uint64_t> perftRootMoves(CBoard &board, const CMoveList &moves, int depth, const PerftOptions &options) {
+  std::vector<uint64_t> res;
+
+  if (options.threads <= 1) {
+    for (CMove move: moves) {
+      board.makeMove(move);
+      res.push_back(perft(board, depth - 1, options.table));
+      board.unmakeMove();
+    }
+    return res;
+  }
+
+  CThreadPool pool(options.threads);
+  std::vector<std::atomic<uint64_t>> counters(moves.size());
+
+  for (int i = 0; i < moves.size(); ++i) {
+    CBoard child = board;
+    child.makeMove(moves[i]);
+    submitPerft(pool, options.table, child, depth - 1, 1, counters[i]);
+  }
+
+  pool.wait();
+
+  for (auto &counter: counters)
+    res.push_back(counter);
+
+  return res;
+}
+
+
+static uint64_t perft(CBoard &board, int depth, const PerftOptions &options) {
+  if (depth <= 1)
+    return perft(board, depth);
+
+  CMoveList moves;
+  board.generateMoves(moves);
+
+  uint64_t nodes = 0;
+  for (uint64_t count: perftRootMoves(board, moves, depth, options))
+    nodes += count;
+
+  return nodes;
+}
+
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(uint64_t nodes, double seconds) {
+  printf("nodes %llu  time %.3f s  %.2f Mnps\n", static_cast<unsigned long long>(nodes), seconds,
+         seconds > 0 ? static_cast<double>(nodes) / seconds / 1e6 : 0.0);
+}
+
+
+static void runPerft(CBoard &board, int maxDepth, const PerftOptions &options) {
+  for (int depth = 1; depth <= maxDepth; ++depth) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = perft(board, depth, options);
+
+    printf("depth %2d  ", depth);
+    report(nodes, secondsSince(start));
+  }
+}
+
+
+static void runDivide(CBoard &board, int depth, const PerftOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  uint64_t total = 0;
+
+  CMoveList moves;
+  board.generateMoves(moves);
+
+  std::vector<uint64_t> counts = perftRootMoves(board, moves, depth, options);
+
+  for (int i = 0; i < moves.size(); ++i) {
+    printf("%s: %llu\n", moves[i].toString().c_str(), static_cast<unsigned long long>(counts[i]));
+    total += counts[i];
+  }
+
+  printf("\nmoves %d  ", moves.size());
+  report(total, secondsSince(start));
+}
+
+
+static bool runBench(const PerftOptions &options) {
+  bool passed = true;
+  uint64_t totalNodes = 0;
+  auto totalStart = std::chrono::steady_clock::now();
+
+  for (const auto &position: perftSuite) {
+    CBoard board;
+    board.loadFen(position.fen);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = perft(board, position.depth, options);
+    totalNodes += nodes;
+
+    bool ok = nodes == position.nodes;
+    passed &= ok;
+
+    printf("%-10s depth %d  %s  ", position.name, position.depth, ok ? "OK  " : "FAIL");
+    report(nodes, secondsSince(start));
+
+    if (!ok)
+      printf("           expected %llu\n", static_cast<unsigned long long>(position.nodes));
+  }
+
+  printf("\ntotal      ");
+  report(totalNodes, secondsSince(totalStart));
+
+  return passed;
+}
+
+
+static std::string joinArguments(int argc, char *argv[], int from) {
+  std::string res;
+
+  for (int i = from; i < argc; ++i)
+    res += std::string(i > from ? " " : "") + argv[i];
+
+  return res.empty() ? START_FEN : res;
+}
+
+
+int main(int argc, char *argv[]) {
+  PerftOptions options;
+  std::unique_ptr<CPerftTable> table;
+  std::vector<char *> args;
+
+  // Options may be given anywhere, the rest are positional arguments
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if ((arg == "-t" || arg == "-H") && i + 1 < argc) {
+      int value = std::atoi(argv[++i]);
+      if (arg == "-t")
+        options.threads = value > 0 ? value : static_cast<int>(std::thread::hardware_concurrency());
+      else if (value > 0) {
+        table = std::make_unique<CPerftTable>(static_cast<size_t>(value));
+        options.table = table.get();
+      }
+    } else
+      args.push_back(argv[i]);
+  }
+
+  std::string command = args.empty() ? "" : args[0];
+
+  if (command == "-h" || command == "--help") {
+    printf("usage: chess_perft [options] [depth] [fen]           perft for every depth up to the given one\n"
+           "       chess_perft [options] divide <depth> [fen]    node counts below every root move\n"
+           "       chess_perft [options] bench                   standard positions, fails on a wrong node count\n"
+           "\n"
+           "options: -t <threads>   split the tree over a work-stealing pool (0 = all cores)\n"
+           "         -H <MB>        share subtree counts in a hash table of the given size\n");
+    return 0;
+  }
+
+  if (command == "bench")
+    return runBench(options) ? 0 : 1;
+
+  CBoard board;
+  bool divide = command == "divide";
+  int argDepth = divide ? 1 : 0;
+
+  int depth = static_cast<int>(args.size()) > argDepth ? std::atoi(args[argDepth]) : 5;
+  std::string fen = joinArguments(static_cast<int>(args.size()), args.data(), argDepth + 1);
+
+  if (depth < 1 || !board.loadFen(fen)) {
+    fprintf(stderr, "invalid depth or FEN: %s\n", fen.c_str());
+    return 1;
+  }
+
+  if (divide)
+    runDivide(board, depth, options);
+  else
+    runPerft(board, depth, options);
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+//
+// Created by Petr Smerda on 05.10.2024.
+//
+
+#include "CTablebaseGenerator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+
+int main(int argc, char *argv[]) {
+  int threads = 1, allPieces = 0;
+  std::vector<std::string> args;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if ((arg == "-t" || arg == "-a") && i + 1 < argc) {
+      int value = std::atoi(argv[++i]);
+      if (arg == "-t")
+        threads = value > 0 ? value : static_cast<int>(std::thread::hardware_concurrency());
+      else
+        allPieces = value;
+    } else
+      args.push_back(arg);
+  }
+
+  if (args.empty() || args[0] == "-h" || args[0] == "--help" || (args.size() == 1 && allPieces == 0)) {
+    printf("usage: chess_tbgen [options] <directory> <ending>...    e.g. KQvKR, smaller endings are made as well\n"
+           "       chess_tbgen [options] -a <pieces> <directory>    every pawnless ending up to the given size\n"
+           "\n"
+           "options: -t <threads>   generate on a thread pool (0 = all cores)\n");
+    return args.empty() ? 1 : 0;
+  }
+
+  std::string directory = args[0];
+  std::filesystem::create_directories(directory);
+
+  std::vector<CTablebase::Material> endings;
+  if (allPieces > CTablebase::MAX_PIECES) {
+    fprintf(stderr, "at most %d pieces\n", CTablebase::MAX_PIECES);
+    return 1;
+  }
+
+  if (allPieces > 0)
+    endings = CTablebaseGenerator::allEndings(allPieces);
+
+  for (size_t i = 1; i < args.size(); ++i) {
+    CTablebase::Material material;
+    if (!CTablebase::Material::parse(args[i], material)) {
+      fprintf(stderr, "invalid ending: %s\n", args[i].c_str());
+      return 1;
+    }
+    endings.push_back(material);
+  }
+
+  CTablebaseGenerator generator(directory, threads);
+
+  for (const CTablebase::Material &material: endings)
+    if (!generator.generate(material))
+      return 1;
+
+  return 0;
+}
@@ -0,0 +1,361 @@
+//
+// Created by Petr Smerda on 10.10.2024.
+//
+
+#include "CBoard.h"
+#include "CNnue.h"
+#include "CSearchThread.h"
+#include "CTablebase.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+
+static const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static const int DEFAULT_HASH = 64;
+static const int MAX_HASH = 65536;
+static const int MAX_THREADS = 256;
+
+
+// UCI front end (https://www.chessprogramming.org/UCI). This thread only reads the commands, the search runs on the
+// thread of CSearchThread and prints its info lines and the best move from there, so a stop is handled at once.
+class CUciEngine {
+public:
+  CUciEngine() : m_engine(DEFAULT_HASH, 1) {
+    m_engine.setInfoCallback([this](const SearchResult &info) { sendInfo(info); });
+    m_engine.setDoneCallback([this](const SearchResult &result) { searchDone(result); });
+    m_board.loadFen(START_FEN);
+  }
+
+  // Returns false on quit
+  bool command(const std::string &line) {
+    std::istringstream input(line);
+    std::string token;
+    input >> token;
+
+    if (token == "uci") {
+      send("id name chess_engine\n"
+           "id author Petr Smerda\n"
+           "option name Hash type spin default " + std::to_string(DEFAULT_HASH) + " min 1 max " + std::to_string(MAX_HASH) + "\n"
+           "option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS) + "\n"
+           "option name Ponder type check default false\n"
+           "option name EvalFile type string default <empty>\n"
+           "option name TablebasePath type string default <empty>\n"
+           "uciok");
+    } else if (token == "isready")
+      send("readyok");
+    else if (token == "ucinewgame") {
+      stopSearch();
+      m_engine.tt().clear();
+      m_engine.pool().clearEvalCaches();
+      m_board.loadFen(START_FEN);
+    } else if (token == "position")
+      position(input);
+    else if (token == "go")
+      go(input);
+    else if (token == "stop")
+      stop();
+    else if (token == "ponderhit")
+      ponderhit();
+    else if (token == "setoption")
+      setOption(input);
+    else if (token == "quit") {
+      stopSearch();
+      return false;
+    }
+
+    return true;
+  }
+
+private:
+  CSearchThread m_engine;
+  CBoard m_board;
+
+  // Guards the output and the held result, the search thread writes as well
+  std::mutex m_mutex;
+
+  // While pondering or searching infinitely the best move may be sent only after a stop or ponderhit
+  bool m_holdResult = false;
+  bool m_resultPending = false;
+  SearchResult m_pendingResult;
+
+
+  void send(const std::string &text) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::cout << text << std::endl;
+  }
+
+
+  // Waits for the running search to end and sends its best move, if still held
+  void stopSearch() {
+    stop();
+    m_engine.wait();
+  }
+
+
+  /******************************************************************************************************************
+   *                                              Position and search                                               *
+   ******************************************************************************************************************/
+
+  // position startpos | fen <fen> [moves <move>...]
+  void position(std::istringstream &input) {
+    std::string token, fen;
+    input >> token;
+
+    if (token == "startpos") {
+      fen = START_FEN;
+      input >> token;
+    } else if (token == "fen") {
+      while (input >> token && token != "moves")
+        fen += fen.empty() ? token : " " + token;
+    } else
+      return;
+
+    stopSearch();
+
+    if (!m_board.loadFen(fen)) {
+      std::cerr << "invalid FEN: " << fen << std::endl;
+      m_board.loadFen(START_FEN);
+      return;
+    }
+
+    while (input >> token) {
+      CMove move = parseMove(token);
+      if (!m_board.makeMove(move)) {
+        std::cerr << "illegal move: " << token << std::endl;
+        return;
+      }
+    }
+  }
+
+
+  // Coordinate notation, e2e4 or e7e8q
+  static bool isCoordinate(const std::string &text) {
+    return text.size() >= 4 && text.size() <= 5 && text[0] >= 'a' && text[0] <= 'h' && text[1] >= '1' &&
+           text[1] <= '8' && text[2] >= 'a' && text[2] <= 'h' && text[3] >= '1' && text[3] <= '8';
+  }
+
+
+  CMove parseMove(const std::string &text) const {
+    if (!isCoordinate(text))
+      return CMove();
+
+    int from = (text[0] - 'a') + (text[1] - '1') * 8;
+    int to = (text[2] - 'a') + (text[3] - '1') * 8;
+    char promotion = text.size() > 4 ? static_cast<char>(std::toupper(static_cast<unsigned char>(text[4]))) : 'Q';
+
+    return m_board.findMove(1ULL << from, 1ULL << to, promotion);
+  }
+
+
+  void go(std::istringstream &input) {
+    SearchLimits limits;
+    int64_t time[2] = {0, 0}, increment[2] = {0, 0};
+    int64_t movesToGo = 0;
+    bool infinite = false;
+    bool pending = false;  // The token ending the moves of searchmoves is already read
+    std::string token;
+
+    while (pending || input >> token) {
+      pending = false;
+
+      if (token == "infinite")
+        infinite = true;
+      else if (token == "ponder")
+        limits.ponder = true;
+      else if (token == "searchmoves") {
+        // The moves run up to the next parameter, illegal ones are left out
+        while (input >> token) {
+          if (!isCoordinate(token)) {
+            pending = true;
+            break;
+          }
+
+          if (CMove move = parseMove(token))
+            limits.searchMoves.push_back(move);
+        }
+      } else {
+        int64_t value = 0;
+        if (!(input >> value))
+          break;
+
+        if (token == "wtime")
+          time[0] = value;
+        else if (token == "btime")
+          time[1] = value;
+        else if (token == "winc")
+          increment[0] = value;
+        else if (token == "binc")
+          increment[1] = value;
+        else if (token == "movestogo")
+          movesToGo = value;
+        else if (token == "movetime")
+          limits.timeMs = std::max<int64_t>(1, value);
+        else if (token == "depth")
+          limits.depth = static_cast<int>(std::clamp<int64_t>(value, 1, CSearch::MAX_PLY - 1));
+        else if (token == "nodes")
+          limits.nodes = static_cast<uint64_t>(std::max<int64_t>(1, value));
+      }
+    }
+
+    // Without any limit the search runs until stopped, like go infinite
+    if (!limits.depth && !limits.nodes && !limits.timeMs && !time[0] && !time[1])
+      infinite = true;
+
+    // A share of the remaining time, with a margin for the communication with the GUI
+    int side = m_board.whiteToMove() ? 0 : 1;
+    if (!infinite && !limits.timeMs && time[side] > 0) {
+      int64_t share = time[side] / (movesToGo > 0 ? movesToGo : 30) + increment[side] * 3 / 4;
+      limits.timeMs = std::max<int64_t>(10, std::min(share, time[side] - 50));
+    }
+
+    stopSearch();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_holdResult = infinite || limits.ponder;
+      m_resultPending = false;
+    }
+
+    m_engine.start(m_board, limits);
+  }
+
+
+  void stop() {
+    releaseResult();
+    m_engine.stop();
+  }
+
+
+  void ponderhit() {
+    releaseResult();
+    m_engine.ponderhit();
+  }
+
+
+  // The best move may be sent as soon as the search ends
+  void releaseResult() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_holdResult = false;
+
+    if (m_resultPending) {
+      m_resultPending = false;
+      sendBestMove(m_pendingResult);
+    }
+  }
+
+
+  /******************************************************************************************************************
+   *                                                Search output                                                   *
+   ******************************************************************************************************************/
+
+  // Called on the search thread
+  void sendInfo(const SearchResult &info) {
+    std::ostringstream text;
+    text << "info depth " << info.depth << " score ";
+
+    if (CSearch::isMateScore(info.score)) {
+      int moves = (CSearch::MATE_VALUE - std::abs(info.score) + 1) / 2;
+      text << "mate " << (info.score > 0 ? moves : -moves);
+    } else
+      text << "cp " << info.score;
+
+    text << " nodes " << info.nodes << " nps " << (info.timeMs > 0 ? info.nodes * 1000 / info.timeMs : info.nodes)
+         << " time " << info.timeMs << " hashfull " << m_engine.tt().hashfull();
+
+    if (info.tbHits)
+      text << " tbhits " << info.tbHits;
+
+    if (!info.pv.empty()) {
+      text << " pv";
+      for (CMove move: info.pv)
+        text << " " << move.toString();
+    }
+
+    // A string takes the rest of the line, so it comes last
+    if (info.dtz >= 0)
+      text << " string dtz " << info.dtz;
+
+    send(text.str());
+  }
+
+
+  // Called on the search thread
+  void searchDone(const SearchResult &result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_holdResult) {
+      m_pendingResult = result;
+      m_resultPending = true;
+    } else
+      sendBestMove(result);
+  }
+
+
+  // Expects the mutex to be locked
+  static void sendBestMove(const SearchResult &result) {
+    // Without any legal move the GUI still needs an answer
+    std::cout << "bestmove " << (result.bestMove ? result.bestMove.toString() : "0000");
+    if (result.bestMove && result.pv.size() > 1)
+      std::cout << " ponder " << result.pv[1].toString();
+    std::cout << std::endl;
+  }
+
+
+  /******************************************************************************************************************
+   *                                                   Options                                                      *
+   ******************************************************************************************************************/
+
+  // setoption name <name> [value <value>], both may contain spaces
+  void setOption(std::istringstream &input) {
+    std::string token, name, value;
+    input >> token;
+
+    while (input >> token && token != "value")
+      name += name.empty() ? token : " " + token;
+    while (input >> token)
+      value += value.empty() ? token : " " + token;
+
+    // None of them may change under a running search
+    stopSearch();
+
+    if (name == "Hash")
+      m_engine.tt().resize(static_cast<size_t>(std::clamp(std::atoi(value.c_str()), 1, MAX_HASH)));
+    else if (name == "Threads")
+      m_engine.pool().setThreads(std::clamp(std::atoi(value.c_str()), 1, MAX_THREADS));
+    else if (name == "EvalFile") {
+      if (value.empty() || value == "<empty>")
+        CNnue::unload();
+      else if (CNnue::load(value))
+        send(std::string("info string NNUE ") + value + " loaded, " + CNnue::simdName() + " kernels");
+      else
+        send("info string cannot load NNUE " + value);
+
+      // Scores of the previous evaluation must not mix with the new ones
+      m_engine.tt().clear();
+      m_engine.pool().clearEvalCaches();
+    } else if (name == "TablebasePath") {
+      if (!value.empty() && value != "<empty>")
+        send("info string " + std::to_string(CTablebase::init(value)) + " tablebases loaded from " + value);
+    } else if (name != "Ponder")
+      send("info string unknown option " + name);
+  }
+};
+
+
+int main() {
+  CUciEngine engine;
+  std::string line;
+
+  while (std::getline(std::cin, line))
+    if (!engine.command(line))
+      return 0;
+
+  // End of input counts as quit, a search still running is stopped
+  engine.command("quit");
+  return 0;
+}